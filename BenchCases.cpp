@@ -0,0 +1,627 @@
+#include "BenchCases.h"
+#include "TransformKernel.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include <iterator>
+#include <glm/gtc/matrix_transform.hpp>
+
+using namespace std;
+using namespace ShaderInterface;
+
+namespace {
+    // every sample variant shades the same full resolution plane kLayers
+    // times per frame with depth testing off, so the time is dominated by
+    // fragment work; gpu us/unit is the cost of one layer
+    const int kLayers = 32;
+    // plus one vertex bound case: the bunny shrunk to a few pixels, drawn
+    // kBunnies times with the brick's variant
+    const int kBunnies = 64;
+    // the render queue with kObjects small planes and bunnies
+    const int kObjects = 256;
+    // instancing: kInstanceCounts[i] bunnies as one instanced draw and (up
+    // to kMaxSeparateDraws) as one draw each
+    const int kInstanceCounts[] = { 1, 10, 100, 1000, 10000, 100000 };
+    const int kMaxSeparateDraws = 10000;
+    // the scene systems over kSceneObjects spinning objects
+    const int kSceneObjects = 20000;
+    // occlusion queries: kQueryObjects bunnies behind a wall
+    const int kQueryObjects = 2000;
+    // the hierarchy: kBvhSizes[i] objects, and kBvhQueries small box queries
+    const int kBvhSizes[] = { 1000, 10000, 100000 };
+    const int kBvhQueries = 64;
+    // the geometry pool: kPoolChurn allocations and frees per frame; frees
+    // get likelier the more ranges are live, which settles around half of kPoolLiveLimit
+    const int kPoolChurn = 1000;
+    const size_t kPoolLiveLimit = 200;
+
+    // CPU only cases have nothing to wait for
+    bool alwaysReady()
+    {
+        return true;
+    }
+}
+
+BenchCases::BenchCases(const Context& context, int measuredFrames)
+    : context(context), benchmark(measuredFrames / 4, measuredFrames), pool(1 << 16, 1 << 18), gpuScene(nullptr)
+{
+}
+
+void BenchCases::setup()
+{
+    addSampleCases();
+    addQueueCases();
+    addPoolCases();
+    addInstancingCases();
+    addSceneCases();
+    addOcclusionCases();
+    addQueryCases();
+    addBvhCases();
+    addGpuCullCases();
+}
+
+Benchmark::ReadyFunc BenchCases::readyFor(const vector<unsigned int>& features, const vector<ShaderBuildQueue::Handle>& programs) const
+{
+    return [this, features, programs]() {
+        for (unsigned int bits : features) {
+            if (!context.sampleVariants->ready(bits))
+                return false;
+        }
+        for (ShaderBuildQueue::Handle program : programs) {
+            if (!context.buildQueue->ready(program))
+                return false;
+        }
+        return context.streamer->idle();
+    };
+}
+
+void BenchCases::useSampleProgram(unsigned int features, const glm::mat4& transform, const glm::mat3& normalMatrix)
+{
+    GLState& glState = *context.glState;
+    GLuint program = context.sampleVariants->program(features);
+    glState.useProgram(program);
+    UniformTable& uniforms = context.sampleVariants->uniforms(features);
+    uniforms.bind(program);
+
+    UniformBlock<ObjectData>& objectUniforms = *context.objectUniforms;
+    objectUniforms.data.transform = transform;
+    objectUniforms.data.normalMatrix = normalMatrix;
+    objectUniforms.data.specStr = context.brick.specStr;
+    objectUniforms.data.specPhong = context.brick.specPhong;
+    objectUniforms.upload();
+
+    glState.bindTexture(Sample::Unit::tex0, GL_TEXTURE_2D, context.brick.albedo);
+    uniforms.set(Sample::Uniform::tex0, Sample::Unit::tex0);
+    glState.bindTexture(Sample::Unit::norm_tex, GL_TEXTURE_2D, context.brick.normalMap);
+    uniforms.set(Sample::Uniform::norm_tex, Sample::Unit::norm_tex);
+}
+
+void BenchCases::submit(bool sorted)
+{
+    RenderQueue& renderQueue = *context.renderQueue;
+    if (sorted)
+        renderQueue.sort();
+    renderQueue.submit(*context.glState, *context.objectUniforms);
+    renderQueue.clear();
+}
+
+void BenchCases::addSampleCases()
+{
+    ShaderVariants& sampleVariants = *context.sampleVariants;
+    glm::mat3 planeNormalMatrix = glm::transpose(glm::inverse(glm::mat3(context.planeTransform)));
+    for (unsigned int features = 0; features < (1u << kSampleFeatureCount); features++) {
+        // the plane has no instance attributes, those are covered below,
+        // and multi draws only come out of the render queue
+        if (features & (FEATURE_INSTANCED | FEATURE_MULTI_DRAW))
+            continue;
+        sampleVariants.prepare(features);
+        benchmark.add("sample[" + sampleVariants.name(features) + "]",
+            [this, features, planeNormalMatrix]() {
+                useSampleProgram(features, context.planeTransform, planeNormalMatrix);
+                GLState& glState = *context.glState;
+                glState.depthTest(false);
+                glState.bindVertexArray(context.geometry->vao());
+                for (int layer = 0; layer < kLayers; layer++)
+                    glDrawArrays(GL_TRIANGLES, context.planeRenderable.first, context.planeRenderable.count);
+                glState.depthTest(true);
+            },
+            readyFor({ features }),
+            kLayers);
+    }
+
+    bunnyMesh.load("3D/bunny.obj");
+    bunnyInstances.attach(bunnyMesh.vao());
+    // Mesh and InstanceBuffer bind their VAOs behind the cache
+    context.glState->invalidate();
+
+    glm::mat4 bunnyTransform = glm::translate(glm::mat4(1.f), glm::vec3(context.planeTransform[3]));
+    bunnyTransform = glm::scale(bunnyTransform, glm::vec3(0.05f));
+    glm::mat3 bunnyNormalMatrix = glm::transpose(glm::inverse(glm::mat3(bunnyTransform)));
+    unsigned int bunnyFeatures = context.brick.features();
+    benchmark.add("sample[" + sampleVariants.name(bunnyFeatures) + "] bunny",
+        [this, bunnyFeatures, bunnyTransform, bunnyNormalMatrix]() {
+            useSampleProgram(bunnyFeatures, bunnyTransform, bunnyNormalMatrix);
+            context.glState->bindVertexArray(bunnyMesh.vao());
+            for (int bunny = 0; bunny < kBunnies; bunny++)
+                glDrawElements(GL_TRIANGLES, bunnyMesh.indexCount(), GL_UNSIGNED_INT, 0);
+        },
+        readyFor({ bunnyFeatures }),
+        kBunnies);
+}
+
+void BenchCases::addQueueCases()
+{
+    // the kObjects planes and bunnies spread over an opaque, a cutout and a
+    // blended material, submitted in the order they were added vs sorted vs
+    // sorted with the ones out of view culled
+    TextureStreamer& streamer = *context.streamer;
+    const Material& brick = context.brick;
+    TextureStreamer::Handle grassTex = streamer.load("3D/grass.png");
+    TextureStreamer::Handle yaeTex = streamer.load("3D/yae.png");
+    materials.push_back(brick);
+    materials.push_back({ streamer.texture(grassTex), 0, true, 0.f, brick.specPhong, false, grassTex, -1 });
+    materials.push_back({ streamer.texture(yaeTex), 0, false, brick.specStr, brick.specPhong, true, yaeTex, -1 });
+    vector<unsigned int> materialFeatures;
+    for (const Material& material : materials) {
+        context.sampleVariants->prepare(material.features());
+        materialFeatures.push_back(material.features());
+    }
+
+    srand(1);
+    for (int i = 0; i < kObjects; i++) {
+        Entity object = objectScene.create();
+        unsigned int material = rand() % (unsigned int)materials.size();
+        bool bunny = rand() % 2 == 0;
+        if (bunny) {
+            objectScene.setRenderable(object, { material, bunnyMesh.vao(), bunnyMesh.indexCount(), true, 0, 0 });
+        }
+        else {
+            Scene::Renderable plane = context.planeRenderable;
+            plane.material = material;
+            objectScene.setRenderable(object, plane);
+        }
+        objectScene.setPosition(object, glm::vec3((i % 16) - 7.5f, (i / 16) - 7.5f, -(float)(rand() % 20)));
+        objectScene.setScale(object, glm::vec3(bunny ? 0.5f : 0.1f));
+        objectScene.setLocalBounds(object, bunny ? bunnyMesh.bounds() : context.planeBounds);
+    }
+    objectScene.updateTransforms();
+
+    culler.setViewProjection(context.viewProjection);
+    const char* queueCases[] = { "queue unsorted", "queue sorted", "queue sorted + culled" };
+    for (int mode = 0; mode < 3; mode++) {
+        benchmark.add(queueCases[mode],
+            [this, mode]() {
+                const vector<uint8_t>* visible = nullptr;
+                if (mode == 2) {
+                    culler.cull(objectScene);
+                    visible = &culler.visible();
+                }
+                context.queueScene(objectScene, materials, visible);
+                submit(mode > 0);
+            },
+            readyFor(materialFeatures),
+            kObjects);
+    }
+
+    // the same scene with its bunnies in the geometry pool next to the
+    // planes, so all of it shares one VAO (and multi draws)
+    pooledBunny.load("3D/bunny.obj", context.geometry);
+    pooledScene = objectScene;
+    for (size_t i = 0; i < pooledScene.size(); i++) {
+        Scene::Renderable renderable = pooledScene.renderables()[i];
+        if (renderable.vao != bunnyMesh.vao())
+            continue;
+        renderable.vao = pooledBunny.vao();
+        renderable.first = pooledBunny.firstIndex();
+        renderable.baseVertex = pooledBunny.baseVertex();
+        pooledScene.setRenderable(pooledScene.entityAt(i), renderable);
+    }
+    benchmark.add("queue sorted pooled",
+        [this]() {
+            context.queueScene(pooledScene, materials, nullptr);
+            submit(true);
+        },
+        readyFor(materialFeatures),
+        kObjects);
+}
+
+void BenchCases::addPoolCases()
+{
+    // kPoolChurn allocations and frees of mesh sized ranges in a pool of its
+    // own, then half of them freed and the rest packed together by defragment()
+    benchmark.add("geometry pool churn x" + to_string(kPoolChurn),
+        [this]() {
+            for (int i = 0; i < kPoolChurn; i++) {
+                if ((size_t)(rand() % kPoolLiveLimit) < poolLive.size()) {
+                    size_t victim = rand() % poolLive.size();
+                    pool.free(poolLive[victim]);
+                    poolLive[victim] = poolLive.back();
+                    poolLive.pop_back();
+                    continue;
+                }
+                // reserved only, the contents don't matter here
+                GLsizei vertices = 16 + rand() % 512;
+                GeometryPool::Handle handle = pool.allocate(nullptr, vertices, nullptr, vertices * 3);
+                if (handle != GeometryPool::kInvalid)
+                    poolLive.push_back(handle);
+            }
+        },
+        alwaysReady,
+        kPoolChurn);
+    benchmark.add("geometry pool defragment",
+        [this]() {
+            size_t live = poolLive.size();
+            for (size_t i = 0; i < poolLive.size(); i++) {
+                pool.free(poolLive[i]);
+                poolLive[i] = poolLive.back();
+                poolLive.pop_back();
+            }
+            pool.defragment();
+            while (poolLive.size() < live) {
+                GLsizei vertices = 16 + rand() % 512;
+                GeometryPool::Handle handle = pool.allocate(nullptr, vertices, nullptr, vertices * 3);
+                if (handle == GeometryPool::kInvalid)
+                    break;
+                poolLive.push_back(handle);
+            }
+        },
+        alwaysReady,
+        1);
+}
+
+void BenchCases::addInstancingCases()
+{
+    // bunnies scattered in front of the camera; gpu us/unit is the cost of one bunny
+    const int kMaxInstances = kInstanceCounts[size(kInstanceCounts) - 1];
+    for (int i = 0; i < kMaxInstances; i++) {
+        glm::vec3 position(rand() % 1600 / 100.f - 8.f, rand() % 1400 / 100.f - 4.f, -(rand() % 3000 / 100.f));
+        glm::vec3 tint(0.5f + rand() % 50 / 100.f, 0.5f + rand() % 50 / 100.f, 0.5f + rand() % 50 / 100.f);
+        instances.push_back({ glm::scale(glm::translate(glm::mat4(1.f), position), glm::vec3(2.f)), glm::vec4(tint, 1.f) });
+    }
+    unsigned int bunnyFeatures = context.brick.features();
+    unsigned int instancedFeatures = bunnyFeatures | FEATURE_INSTANCED;
+    context.sampleVariants->prepare(instancedFeatures);
+    unsigned int multiDrawFeatures = bunnyFeatures | FEATURE_MULTI_DRAW;
+    bool multiDraw = context.renderQueue->multiDrawEnabled();
+    if (multiDraw)
+        context.sampleVariants->prepare(multiDrawFeatures);
+
+    for (int count : kInstanceCounts) {
+        benchmark.add("bunny instanced x" + to_string(count),
+            [this, count]() {
+                // the instances don't move, so each case uploads them once
+                if (bunnyInstances.count() != count)
+                    bunnyInstances.upload(instances.data(), count);
+                context.queueSampleDraw(context.brick, 0, bunnyMesh.vao(), bunnyMesh.indexCount(), true, glm::mat4(1.f),
+                    glm::mat3(1.f), count, 0, 0);
+                submit(false);
+            },
+            readyFor({ instancedFeatures }),
+            count);
+        if (count > kMaxSeparateDraws)
+            continue;
+        // the same draws one by one and as one multi draw
+        auto queueBunnies = [this, count]() {
+            for (int i = 0; i < count; i++) {
+                const glm::mat4& transform = instances[i].transform;
+                context.queueSampleDraw(context.brick, 0, bunnyMesh.vao(), bunnyMesh.indexCount(), true, transform,
+                    glm::transpose(glm::inverse(glm::mat3(transform))), 0, 0, 0);
+            }
+            submit(false);
+        };
+        benchmark.add("bunny draws x" + to_string(count),
+            [this, queueBunnies]() {
+                RenderQueue& renderQueue = *context.renderQueue;
+                bool multiDraw = renderQueue.multiDrawEnabled();
+                renderQueue.setMultiDraw(false);
+                queueBunnies();
+                renderQueue.setMultiDraw(multiDraw);
+            },
+            readyFor({ bunnyFeatures }),
+            count);
+        if (!multiDraw)
+            continue;
+        benchmark.add("bunny multi draw x" + to_string(count),
+            queueBunnies,
+            readyFor({ multiDrawFeatures }),
+            count);
+    }
+}
+
+void BenchCases::addSceneCases()
+{
+    // the transforms alone composed by glm one at a time vs the SIMD kernel
+    // on one thread and on the pool; cpu M units/s is matrices per second
+    // the same objects are frustum culled one at a time and four per SSE step
+    WorkerPool& workers = *context.workers;
+    for (int i = 0; i < kSceneObjects; i++) {
+        Entity object = spinScene.create();
+        spinScene.setPosition(object, glm::vec3(rand() % 2000 / 100.f - 10.f, rand() % 2000 / 100.f - 10.f, -(rand() % 2000 / 100.f)));
+        spinScene.setScale(object, glm::vec3(0.5f));
+        spinScene.setSpin(object, 1.f + rand() % 100 / 100.f, glm::vec3(rand() % 100 / 100.f, 1.f, 0.f));
+        spinScene.setLocalBounds(object, bunnyMesh.bounds());
+        spinScene.setRenderable(object, { 0, bunnyMesh.vao(), bunnyMesh.indexCount(), true, 0, 0 });
+    }
+    spinScene.updateTransforms();
+    worlds.resize(kSceneObjects);
+    normals.resize(kSceneObjects);
+    benchmark.add("transforms glm x" + to_string(kSceneObjects),
+        [this]() {
+            TransformKernel::Arrays in = spinScene.transformArrays();
+            for (int i = 0; i < kSceneObjects; i++) {
+                glm::mat4 world = glm::translate(glm::mat4(1.f), glm::vec3(in.positionX[i], in.positionY[i], in.positionZ[i]));
+                world = glm::scale(world, glm::vec3(in.scaleX[i], in.scaleY[i], in.scaleZ[i]));
+                world = world * glm::mat4_cast(glm::quat(in.rotationW[i], in.rotationX[i], in.rotationY[i], in.rotationZ[i]));
+                worlds[i] = world;
+                normals[i] = glm::transpose(glm::inverse(glm::mat3(world)));
+            }
+        },
+        alwaysReady,
+        kSceneObjects);
+    benchmark.add("transforms sse x" + to_string(kSceneObjects),
+        [this]() {
+            TransformKernel::compose(spinScene.transformArrays(), 0, kSceneObjects, worlds.data(), normals.data());
+        },
+        alwaysReady,
+        kSceneObjects);
+    benchmark.add("transforms sse " + to_string(workers.threadCount()) + " threads x" + to_string(kSceneObjects),
+        [this]() {
+            TransformKernel::Arrays in = spinScene.transformArrays();
+            context.workers->parallelFor(kSceneObjects, 1024, [&](size_t begin, size_t end) {
+                TransformKernel::compose(in, begin, end, worlds.data(), normals.data());
+            });
+        },
+        alwaysReady,
+        kSceneObjects);
+    benchmark.add("scene spin + transforms x" + to_string(kSceneObjects),
+        [this]() {
+            spinScene.spin();
+            spinScene.updateTransforms(context.workers);
+        },
+        alwaysReady,
+        kSceneObjects);
+    spinCuller.setViewProjection(context.viewProjection);
+    benchmark.add("frustum cull scalar x" + to_string(kSceneObjects),
+        [this]() {
+            const vector<Bounds>& boxes = spinScene.worldBounds();
+            const Frustum& frustum = spinCuller.frustum();
+            unsigned int visibleCount = 0;
+            for (const Bounds& box : boxes)
+                visibleCount += frustum.intersects(box);
+            // keep the loop from being optimized out
+            if (visibleCount > boxes.size())
+                cout << visibleCount;
+        },
+        alwaysReady,
+        kSceneObjects);
+    benchmark.add("frustum cull sse x" + to_string(kSceneObjects),
+        [this]() { spinCuller.cull(spinScene); },
+        alwaysReady,
+        kSceneObjects);
+    benchmark.add("frustum cull sse " + to_string(workers.threadCount()) + " threads x" + to_string(kSceneObjects),
+        [this]() { spinCuller.cull(spinScene, context.workers); },
+        alwaysReady,
+        kSceneObjects);
+}
+
+void BenchCases::addOcclusionCases()
+{
+    // the bunny blown up and a wall of planes in front of the spinning
+    // objects, rasterized on the pool and on one thread (cpu M units/s is
+    // triangles), then the objects the frustum kept tested against the pyramid
+    WorkerPool& workers = *context.workers;
+    glm::mat4 bunnyOccluder = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(-3.f, -6.f, 0.f)), glm::vec3(40.f));
+    glm::mat4 wallOccluder = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(2.f, 0.f, -8.f)), glm::vec3(6.f));
+    int occluderTriangles = (int)((bunnyMesh.triangles().size() + context.planeTriangles->size()) / 3);
+    auto drawOccluders = [this, bunnyOccluder, wallOccluder](WorkerPool* pool) {
+        occlusion.begin(context.viewProjection);
+        occlusion.addOccluder(bunnyMesh.triangles(), bunnyOccluder);
+        occlusion.addOccluder(*context.planeTriangles, wallOccluder);
+        occlusion.rasterize(pool);
+    };
+    benchmark.add("occluders raster " + to_string(workers.threadCount()) + " threads x" + to_string(occluderTriangles),
+        [this, drawOccluders]() { drawOccluders(context.workers); },
+        alwaysReady,
+        occluderTriangles);
+    benchmark.add("occluders raster 1 thread x" + to_string(occluderTriangles),
+        [drawOccluders]() { drawOccluders(nullptr); },
+        alwaysReady,
+        occluderTriangles);
+    drawOccluders(&workers);
+    spinCuller.cull(spinScene, &workers);
+    occlusionCandidates = spinCuller.visible();
+    benchmark.add("occlusion test x" + to_string(kSceneObjects),
+        [this]() { occlusion.cull(spinScene, occlusionCandidates, context.workers); },
+        alwaysReady,
+        kSceneObjects);
+    occlusion.cull(spinScene, occlusionCandidates, &workers);
+    cout << "occlusion bench: " << occlusion.getStats().culled << " of " << occlusion.getStats().tested
+        << " objects in the frustum are behind the occluders" << endl;
+}
+
+void BenchCases::addQueryCases()
+{
+    // bunnies behind a wall, all drawn vs only the ones whose box query
+    // passed; gpu us/unit is per bunny
+    Entity wall = queryScene.create();
+    queryScene.setPosition(wall, glm::vec3(0.f, 0.f, -4.f));
+    queryScene.setScale(wall, glm::vec3(8.f));
+    queryScene.setLocalBounds(wall, context.planeBounds);
+    queryScene.setRenderable(wall, context.planeRenderable);
+    for (int i = 0; i < kQueryObjects; i++) {
+        Entity object = queryScene.create();
+        queryScene.setPosition(object, glm::vec3(rand() % 2000 / 100.f - 10.f, rand() % 2000 / 100.f - 10.f, -6.f - rand() % 1400 / 100.f));
+        queryScene.setScale(object, glm::vec3(10.f));
+        queryScene.setLocalBounds(object, bunnyMesh.bounds());
+        queryScene.setRenderable(object, { 0, bunnyMesh.vao(), bunnyMesh.indexCount(), true, 0, 0 });
+    }
+    queryScene.updateTransforms();
+    for (int queried = 0; queried < 2; queried++) {
+        benchmark.add(string(queried ? "bunnies behind a wall queried x" : "bunnies behind a wall x") + to_string(kQueryObjects),
+            [this, queried]() {
+                culler.setViewProjection(context.viewProjection);
+                culler.cull(queryScene);
+                const vector<uint8_t>* visible = &culler.visible();
+                if (queried) {
+                    queries.collect();
+                    queries.cull(queryScene, culler.visible());
+                    visible = &queries.visible();
+                }
+                context.queueScene(queryScene, *context.materials, visible);
+                submit(true);
+                if (queried) {
+                    queries.issue(queryScene, culler.visible(), context.viewProjection, *context.glState,
+                        context.buildQueue->program(context.boxProgram), *context.boxUniforms, context.boxVAO, context.boxIndexCount);
+                }
+            },
+            readyFor({ context.brick.features() }, { context.boxProgram }),
+            kQueryObjects);
+    }
+}
+
+void BenchCases::addBvhCases()
+{
+    // objects at the same density around the camera, so most are out of
+    // view; build, refit, the frustum cull linear vs through the tree and
+    // kBvhQueries small box queries
+    for (int i = 0; i < kBvhQueries; i++) {
+        glm::vec3 center(rand() % 2000 / 100.f - 10.f, rand() % 2000 / 100.f - 10.f, rand() % 2000 / 100.f - 10.f);
+        bvhQueries.push_back({ center - glm::vec3(1.f), center + glm::vec3(1.f) });
+    }
+    bvhScenes.resize(size(kBvhSizes));
+    bvhs.resize(size(kBvhSizes));
+    for (size_t s = 0; s < bvhScenes.size(); s++) {
+        int objects = kBvhSizes[s];
+        string suffix = " x" + to_string(objects);
+        Scene* bvhScene = &bvhScenes[s];
+        Bvh* bvh = &bvhs[s];
+        // a cube holding about one object per unit of volume
+        float side = cbrt((float)objects);
+        for (int i = 0; i < objects; i++) {
+            Entity object = bvhScene->create();
+            glm::vec3 position(rand() % 10000 / 10000.f, rand() % 10000 / 10000.f, rand() % 10000 / 10000.f);
+            bvhScene->setPosition(object, (position - glm::vec3(0.5f)) * side);
+            bvhScene->setScale(object, glm::vec3(0.25f));
+            bvhScene->rotate(object, (float)(rand() % 360), glm::vec3(0.f, 1.f, 0.f));
+            bvhScene->setLocalBounds(object, bunnyMesh.bounds());
+            bvhScene->setRenderable(object, { 0, bunnyMesh.vao(), bunnyMesh.indexCount(), true, 0, 0 });
+        }
+        bvhScene->updateTransforms();
+        bvh->build(bvhScene->worldBounds());
+        benchmark.add("bvh build" + suffix,
+            [bvh, bvhScene]() { bvh->build(bvhScene->worldBounds()); },
+            alwaysReady,
+            objects);
+        benchmark.add("bvh refit" + suffix,
+            [bvh, bvhScene]() { bvh->refit(bvhScene->worldBounds()); },
+            alwaysReady,
+            objects);
+        benchmark.add("bvh cull linear sse" + suffix,
+            [this, bvhScene]() { spinCuller.cull(*bvhScene); },
+            alwaysReady,
+            objects);
+        benchmark.add("bvh cull tree" + suffix,
+            [this, bvh, bvhScene]() { spinCuller.cull(*bvhScene, *bvh); },
+            alwaysReady,
+            objects);
+        benchmark.add("bvh box queries x" + to_string(kBvhQueries) + suffix,
+            [this, bvh, bvhScene]() {
+                for (const Bounds& box : bvhQueries) {
+                    bvhHits.clear();
+                    bvh->query(box, bvhScene->worldBounds(), bvhHits);
+                }
+            },
+            alwaysReady,
+            kBvhQueries);
+    }
+}
+
+void BenchCases::addGpuCullCases()
+{
+    // the bvh scenes as bunnies: the cull compute pass and one indirect multi
+    // draw vs the SSE frustum cull and one instanced draw of the visible
+    // ones; gpu us/unit is per object in the scene
+    if (!GpuCuller::supported()) {
+        cout << "gpu cull bench skipped: needs OpenGL 4.3" << endl;
+        return;
+    }
+    gpuMesh.load("3D/bunny.obj");
+    gpuInstances.attach(gpuMesh.vao());
+    context.glState->invalidate();
+
+    unsigned int instancedFeatures = context.brick.features() | FEATURE_INSTANCED;
+    for (size_t s = 0; s < bvhScenes.size(); s++) {
+        int objects = kBvhSizes[s];
+        string suffix = " x" + to_string(objects);
+        Scene* bvhScene = &bvhScenes[s];
+        Bvh* bvh = &bvhs[s];
+        benchmark.add("gpu cull + indirect" + suffix,
+            [this, bvhScene, instancedFeatures]() {
+                // the objects don't move, so each case uploads them once
+                if (gpuScene != bvhScene) {
+                    gpuCuller.upload(*bvhScene, gpuInstances);
+                    gpuScene = bvhScene;
+                }
+                gpuCuller.cull(*context.glState, context.buildQueue->program(context.cullProgram), *context.cullUniforms,
+                    gpuMesh.indexCount());
+
+                useSampleProgram(instancedFeatures, glm::mat4(1.f), glm::mat3(1.f));
+                context.glState->bindVertexArray(gpuMesh.vao());
+                gpuCuller.draw();
+            },
+            readyFor({ instancedFeatures }, { context.cullProgram }),
+            objects);
+        benchmark.add("cpu cull + instanced" + suffix,
+            [this, bvh, bvhScene]() {
+                spinCuller.cull(*bvhScene, *bvh);
+                const vector<uint8_t>& visible = spinCuller.visible();
+                const vector<glm::mat4>& sceneWorlds = bvhScene->worldMatrices();
+                visibleInstances.clear();
+                for (size_t i = 0; i < visible.size(); i++) {
+                    if (visible[i])
+                        visibleInstances.push_back({ sceneWorlds[i], glm::vec4(1.f) });
+                }
+                gpuInstances.upload(visibleInstances);
+                gpuScene = nullptr;
+                if (!visibleInstances.empty()) {
+                    context.queueSampleDraw(context.brick, 0, gpuMesh.vao(), gpuMesh.indexCount(), true, glm::mat4(1.f),
+                        glm::mat3(1.f), (GLsizei)visibleInstances.size(), 0, 0);
+                    submit(false);
+                }
+            },
+            readyFor({ instancedFeatures }),
+            objects);
+    }
+}
+
+void BenchCases::report(ostream& out)
+{
+    benchmark.report(out);
+    const OcclusionQueries::Stats& queryStats = queries.getStats();
+    out << "occlusion queries bench last frame: " << queryStats.issued << " issued, " << queryStats.read
+        << " read, " << queryStats.stallsAvoided << " stalls avoided, " << queryStats.skipped << " bunnies skipped" << endl;
+    GeometryPool::Stats poolStats = pool.getStats();
+    out << "geometry pool bench: " << poolStats.allocations << " ranges, " << poolStats.verticesUsed << " / "
+        << poolStats.vertexCapacity << " vertices, " << poolStats.freeBlocks << " free blocks, "
+        << poolStats.defragmentations << " defragmentations, last moved " << poolStats.bytesMoved / 1024 << " KB" << endl;
+    if (gpuCuller.packed() && gpuCuller.objectCount()) {
+        out << "gpu cull bench last frame: " << gpuCuller.readDrawCount() << " of " << gpuCuller.objectCount()
+            << " objects drawn" << endl;
+    }
+}
+
+void BenchCases::release()
+{
+    // the pooled bunny frees its range in context.geometry, which main() releases after this
+    pooledBunny.release();
+    pool.release();
+    bunnyMesh.release();
+    bunnyInstances.release();
+    gpuMesh.release();
+    gpuInstances.release();
+    gpuCuller.release();
+    queries.release();
+    benchmark.release();
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Benchmark.h"
+#include "ShaderBuildQueue.h"
+#include "ShaderVariants.h"
+#include "TextureStreamer.h"
+#include "UniformTable.h"
+#include "UniformBlock.h"
+#include "ShaderInterface.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "InstanceBuffer.h"
+#include "GpuCuller.h"
+#include "GeometryPool.h"
+#include "Scene.h"
+#include "WorkerPool.h"
+#include "FrustumCuller.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+
+// the --bench cases and the scenes, meshes and pools only they draw
+// main() hands over the systems the frame uses in a Context; setup() adds
+// every case to the Benchmark, grouped by what they measure, frame() runs
+// the current case in place of the scene and report() prints the table and
+// what the bench-only systems counted. a case waits for its programs through
+// readyFor()
+class BenchCases
+{
+public:
+    // main()'s queueSampleDraw: one object drawn with the sample variant of its material
+    typedef std::function<void(const Material& material, unsigned int materialId, GLuint vao, GLsizei count, bool indexed,
+        const glm::mat4& transform, const glm::mat3& normalMatrix, GLsizei instances, GLint first, GLint baseVertex)> QueueDrawFunc;
+    // main()'s queueScene: every renderable of a scene that is visible
+    typedef std::function<void(const Scene& objects, const std::vector<Material>& objectMaterials,
+        const std::vector<uint8_t>* visible)> QueueSceneFunc;
+
+    // owned by main(), everything has to outlive the cases
+    struct Context {
+        ShaderVariants* sampleVariants;
+        ShaderBuildQueue* buildQueue;
+        TextureStreamer* streamer;
+        GLState* glState;
+        UniformBlock<ShaderInterface::ObjectData>* objectUniforms;
+        RenderQueue* renderQueue;
+        WorkerPool* workers;
+        // the bunny of the pooled queue case goes in here, next to the plane
+        GeometryPool* geometry;
+        QueueDrawFunc queueSampleDraw;
+        QueueSceneFunc queueScene;
+
+        // the brick plane: material, where the scene puts it (without the
+        // spin), its pool range, bounds and triangles
+        Material brick;
+        glm::mat4 planeTransform;
+        Scene::Renderable planeRenderable;
+        Bounds planeBounds;
+        const std::vector<glm::vec3>* planeTriangles;
+        // the main scene's materials
+        const std::vector<Material>* materials;
+        glm::mat4 viewProjection;
+
+        // occlusion query boxes: the program, and the unit cube they stretch
+        ShaderBuildQueue::Handle boxProgram;
+        UniformTable* boxUniforms;
+        GLuint boxVAO;
+        GLsizei boxIndexCount;
+        // -1 without GL 4.3
+        ShaderBuildQueue::Handle cullProgram;
+        UniformTable* cullUniforms;
+    };
+
+    BenchCases(const Context& context, int measuredFrames);
+
+    // loads the bench meshes, builds the bench scenes and adds the cases
+    void setup();
+    // one frame of the current case; false once every case is done
+    bool frame() { return benchmark.frame(); }
+    // reads the GPU cull's count back, so not for every frame
+    void report(std::ostream& out);
+
+    void release();
+
+private:
+    // ready once the sample variants of every feature set and the programs
+    // have linked and no texture is streaming any more
+    Benchmark::ReadyFunc readyFor(const std::vector<unsigned int>& features,
+        const std::vector<ShaderBuildQueue::Handle>& programs = std::vector<ShaderBuildQueue::Handle>()) const;
+
+    // in the order they run
+    void addSampleCases();
+    void addQueueCases();
+    void addPoolCases();
+    void addInstancingCases();
+    void addSceneCases();
+    void addOcclusionCases();
+    void addQueryCases();
+    void addBvhCases();
+    void addGpuCullCases();
+
+    // binds the variant for features with the brick's textures and uniforms
+    // and uploads the object data of transform
+    void useSampleProgram(unsigned int features, const glm::mat4& transform, const glm::mat3& normalMatrix);
+    // draws what was queued, sorted or in the order it came, and empties the queue
+    void submit(bool sorted);
+
+    Context context;
+    Benchmark benchmark;
+
+    Mesh bunnyMesh;
+    InstanceBuffer bunnyInstances;
+    std::vector<InstanceBuffer::Instance> instances;
+
+    // small planes and bunnies over an opaque, a cutout and a blended material
+    std::vector<Material> materials;
+    Scene objectScene;
+    FrustumCuller culler;
+    // objectScene with its bunnies in context.geometry
+    Mesh pooledBunny;
+    Scene pooledScene;
+    // a pool of its own for the churn, with the ranges currently allocated
+    GeometryPool pool;
+    std::vector<GeometryPool::Handle> poolLive;
+
+    Scene spinScene;
+    FrustumCuller spinCuller;
+    std::vector<glm::mat4> worlds;
+    std::vector<glm::mat3> normals;
+
+    OcclusionCuller occlusion;
+    std::vector<uint8_t> occlusionCandidates;
+    Scene queryScene;
+    OcclusionQueries queries;
+
+    std::vector<Scene> bvhScenes;
+    std::vector<Bvh> bvhs;
+    std::vector<Bounds> bvhQueries;
+    std::vector<uint32_t> bvhHits;
+
+    Mesh gpuMesh;
+    InstanceBuffer gpuInstances;
+    GpuCuller gpuCuller;
+    // scene whose objects gpuInstances holds for gpuCuller
+    const Scene* gpuScene;
+    std::vector<InstanceBuffer::Instance> visibleInstances;
+};
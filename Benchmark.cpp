@@ -0,0 +1,86 @@
+#include "Benchmark.h"
+
+#include <iomanip>
+
+using namespace std;
+
+Benchmark::Benchmark(int warmupFrames, int measuredFrames)
+    : current(0), frameIndex(0), warmupFrames(warmupFrames), measuredFrames(measuredFrames)
+{
+}
+
+void Benchmark::add(const string& name, DrawFunc draw, ReadyFunc ready, int units)
+{
+    Case entry;
+    entry.name = name;
+    entry.draw = draw;
+    entry.ready = ready;
+    entry.units = units;
+    entry.cpuMs = 0.0;
+    entry.frameMs = 0.0;
+    cases.push_back(entry);
+}
+
+bool Benchmark::frame()
+{
+    if (finished())
+        return false;
+    Case& entry = cases[current];
+    // waiting doesn't count towards the warmup
+    if (entry.ready && !entry.ready())
+        return true;
+
+    auto start = chrono::steady_clock::now();
+    double frameMs = chrono::duration<double, milli>(start - lastFrame).count();
+    lastFrame = start;
+    entry.gpu.begin();
+    entry.draw();
+    entry.gpu.end();
+    double cpuMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    entry.gpu.collect();
+
+    frameIndex++;
+    if (frameIndex == warmupFrames) {
+        // drops the warmup frames still in flight
+        entry.gpu.reset();
+        entry.cpuMs = 0.0;
+        entry.frameMs = 0.0;
+    }
+    else if (frameIndex > warmupFrames) {
+        entry.cpuMs += cpuMs;
+        entry.frameMs += frameMs;
+    }
+    if (frameIndex == warmupFrames + measuredFrames) {
+        entry.gpu.collect(true);
+        current++;
+        frameIndex = 0;
+    }
+    return !finished();
+}
+
+string Benchmark::currentCase() const
+{
+    return finished() ? string() : cases[current].name;
+}
+
+void Benchmark::report(ostream& out) const
+{
+    out << "benchmark: " << measuredFrames << " frames per case after " << warmupFrames << " warmup frames" << endl;
+    out << left << setw(40) << "case" << right << setw(12) << "gpu ms" << setw(14) << "gpu us/unit"
+        << setw(12) << "cpu ms" << setw(14) << "cpu Munit/s" << setw(12) << "frame ms" << endl;
+    out << fixed << setprecision(3);
+    for (const Case& entry : cases) {
+        out << left << setw(40) << entry.name << right << setw(12) << entry.gpu.averageMs()
+            << setw(14) << entry.gpu.averageMs() * 1000.0 / entry.units
+            << setw(12) << entry.cpuMs / measuredFrames
+            << setw(14) << (entry.cpuMs > 0.0 ? entry.units * measuredFrames / entry.cpuMs / 1000.0 : 0.0)
+            << setw(12) << entry.frameMs / measuredFrames << endl;
+    }
+    out << defaultfloat;
+}
+
+void Benchmark::release()
+{
+    for (Case& entry : cases)
+        entry.gpu.release();
+}
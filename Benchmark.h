@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+#include <chrono>
+
+#include "GpuTimer.h"
+
+// fixed-length benchmark run (--bench)
+// the cases run one after the other, each for warmup + measured frames;
+// GPU time comes from a timer query around the case's draw, CPU time is
+// what the draw itself took to submit and frame time is the wall clock from
+// one frame() to the next (swap included). report() prints one row per case;
+// units (draws, layers, instances, ...) splits the GPU time per unit of work
+// and turns the CPU time into units per second.
+class Benchmark
+{
+public:
+    // draws one frame of a case
+    typedef std::function<void()> DrawFunc;
+    // false while the case can't run yet (program still compiling, textures streaming)
+    typedef std::function<bool()> ReadyFunc;
+
+    Benchmark(int warmupFrames = 60, int measuredFrames = 240);
+
+    void add(const std::string& name, DrawFunc draw, ReadyFunc ready = ReadyFunc(), int units = 1);
+    // run one frame of the current case; false once every case is done
+    bool frame();
+    bool finished() const { return current >= cases.size(); }
+    // name of the case that is running, empty once finished
+    std::string currentCase() const;
+
+    void report(std::ostream& out) const;
+
+    void release();
+
+private:
+    struct Case {
+        std::string name;
+        DrawFunc draw;
+        ReadyFunc ready;
+        int units;
+        GpuTimer gpu;
+        double cpuMs;
+        double frameMs;
+    };
+
+    std::vector<Case> cases;
+    size_t current;
+    int frameIndex;
+    int warmupFrames, measuredFrames;
+    std::chrono::steady_clock::time_point lastFrame;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// axis aligned box; empty() has min > max until a point is added
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    static Bounds empty()
+    {
+        return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    }
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void add(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    // box around this one after an affine transform: the center is
+    // transformed, the extent goes through |matrix| (Arvo)
+    Bounds transformed(const glm::mat4& matrix) const
+    {
+        glm::vec3 c = glm::vec3(matrix * glm::vec4(center(), 1.f));
+        glm::vec3 e = extent();
+        glm::vec3 r(
+            fabs(matrix[0][0]) * e.x + fabs(matrix[1][0]) * e.y + fabs(matrix[2][0]) * e.z,
+            fabs(matrix[0][1]) * e.x + fabs(matrix[1][1]) * e.y + fabs(matrix[2][1]) * e.z,
+            fabs(matrix[0][2]) * e.x + fabs(matrix[1][2]) * e.y + fabs(matrix[2][2]) * e.z);
+        return { c - r, c + r };
+    }
+};
@@ -0,0 +1,289 @@
+#include "Bvh.h"
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    float surfaceArea(const Bounds& box)
+    {
+        glm::vec3 size = box.max - box.min;
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    Bounds merge(const Bounds& a, const Bounds& b)
+    {
+        return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+
+    bool overlaps(const Bounds& a, const Bounds& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y
+            && a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    // false if the box is outside one of the planes in planeMask; the planes
+    // it is completely inside of are cleared from the mask
+    bool touches(const Frustum& frustum, const Bounds& box, uint32_t& planeMask)
+    {
+        glm::vec3 center = box.center();
+        glm::vec3 extent = box.extent();
+        for (int plane = 0; plane < 6; plane++) {
+            if (!(planeMask & (1u << plane)))
+                continue;
+            const glm::vec4& p = frustum.planes[plane];
+            float distance = glm::dot(glm::vec3(p), center) + p.w;
+            float radius = fabs(p.x) * extent.x + fabs(p.y) * extent.y + fabs(p.z) * extent.z;
+            if (distance + radius < 0.f)
+                return false;
+            if (distance - radius >= 0.f)
+                planeMask &= ~(1u << plane);
+        }
+        return true;
+    }
+
+    // cost of visiting a node relative to testing one object
+    const float kTraversalCost = 1.f;
+}
+
+Bvh::Bvh()
+    : objects(0)
+{
+}
+
+void Bvh::clear()
+{
+    nodes.clear();
+    order.clear();
+    unbounded.clear();
+    objects = 0;
+}
+
+Bounds Bvh::rangeBounds(uint32_t first, uint32_t count, const vector<Bounds>& boxes) const
+{
+    Bounds bounds = Bounds::empty();
+    for (uint32_t i = first; i < first + count; i++)
+        bounds = merge(bounds, boxes[order[i]]);
+    return bounds;
+}
+
+void Bvh::build(const vector<Bounds>& boxes)
+{
+    clear();
+    objects = boxes.size();
+    // items[i] is order[i] until the end of the build
+    vector<BuildItem> items;
+    items.reserve(boxes.size());
+    Bounds rootBounds = Bounds::empty();
+    for (uint32_t i = 0; i < (uint32_t)boxes.size(); i++) {
+        if (!boxes[i].valid()) {
+            unbounded.push_back(i);
+            continue;
+        }
+        items.push_back({ boxes[i], boxes[i].center(), i });
+        rootBounds = merge(rootBounds, boxes[i]);
+    }
+    if (items.empty())
+        return;
+
+    // at most 2n - 1 nodes
+    nodes.reserve(items.size() * 2);
+    nodes.push_back({ rootBounds, 0, 0, (uint32_t)items.size() });
+    vector<uint32_t> pending = { 0 };
+    while (!pending.empty()) {
+        uint32_t node = pending.back();
+        pending.pop_back();
+        if (split(node, items)) {
+            pending.push_back(nodes[node].child);
+            pending.push_back(nodes[node].child + 1);
+        }
+    }
+
+    order.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        order[i] = items[i].object;
+}
+
+bool Bvh::split(uint32_t nodeIndex, vector<BuildItem>& items)
+{
+    Node node = nodes[nodeIndex];
+    if (node.count <= kMaxLeafObjects)
+        return false;
+    BuildItem* begin = items.data() + node.first;
+    BuildItem* end = begin + node.count;
+
+    Bounds centerBounds = Bounds::empty();
+    for (BuildItem* item = begin; item != end; item++)
+        centerBounds.add(item->center);
+
+    // the cheapest of the kBins - 1 planes between bins, on every axis
+    float bestCost = FLT_MAX;
+    int bestAxis = -1, bestPlane = 0;
+    // boxes of the two sides of the best plane, so the children don't rescan
+    Bounds bestLeft, bestRight;
+    // all three axes binned in one pass over the objects
+    Bounds binBounds[3][kBins];
+    uint32_t binCounts[3][kBins] = {};
+    glm::vec3 low = centerBounds.min;
+    glm::vec3 size = centerBounds.max - centerBounds.min;
+    glm::vec3 scale(size.x > 0.f ? kBins / size.x : 0.f, size.y > 0.f ? kBins / size.y : 0.f, size.z > 0.f ? kBins / size.z : 0.f);
+    for (int axis = 0; axis < 3; axis++) {
+        for (int bin = 0; bin < kBins; bin++)
+            binBounds[axis][bin] = Bounds::empty();
+    }
+    for (BuildItem* item = begin; item != end; item++) {
+        for (int axis = 0; axis < 3; axis++) {
+            int bin = min(kBins - 1, (int)((item->center[axis] - low[axis]) * scale[axis]));
+            binBounds[axis][bin] = merge(binBounds[axis][bin], item->box);
+            binCounts[axis][bin]++;
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (size[axis] <= 0.f)
+            continue;
+        // sweep from the right for the box / count of every right side
+        Bounds rightBounds[kBins];
+        uint32_t rightCounts[kBins];
+        Bounds right = Bounds::empty();
+        uint32_t rightCount = 0;
+        for (int bin = kBins - 1; bin > 0; bin--) {
+            if (binCounts[axis][bin])
+                right = merge(right, binBounds[axis][bin]);
+            rightCount += binCounts[axis][bin];
+            rightBounds[bin] = right;
+            rightCounts[bin] = rightCount;
+        }
+        Bounds left = Bounds::empty();
+        uint32_t leftCount = 0;
+        for (int plane = 1; plane < kBins; plane++) {
+            if (binCounts[axis][plane - 1])
+                left = merge(left, binBounds[axis][plane - 1]);
+            leftCount += binCounts[axis][plane - 1];
+            if (leftCount == 0 || rightCounts[plane] == 0)
+                continue;
+            float cost = surfaceArea(left) * leftCount + surfaceArea(rightBounds[plane]) * rightCounts[plane];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestPlane = plane;
+                bestLeft = left;
+                bestRight = rightBounds[plane];
+            }
+        }
+    }
+
+    BuildItem* middle;
+    // SAH cost of the split vs testing every object of the leaf
+    float leafCost = surfaceArea(node.bounds) * node.count;
+    float splitCost = kTraversalCost * surfaceArea(node.bounds) + bestCost;
+    if (bestAxis >= 0 && splitCost < leafCost) {
+        middle = partition(begin, end, [&](const BuildItem& item) {
+            return min(kBins - 1, (int)((item.center[bestAxis] - low[bestAxis]) * scale[bestAxis])) < bestPlane;
+        });
+    }
+    else if (node.count > kMaxLeafObjects * 8) {
+        // the SAH wants a leaf (or can't tell the centers apart), but one
+        // this big makes every query through it linear: halve it on the
+        // widest axis instead
+        int axis = 0;
+        if (size.y > size[axis])
+            axis = 1;
+        if (size.z > size[axis])
+            axis = 2;
+        middle = begin + node.count / 2;
+        nth_element(begin, middle, end, [&](const BuildItem& a, const BuildItem& b) { return a.center[axis] < b.center[axis]; });
+        bestLeft = bestRight = Bounds::empty();
+        for (BuildItem* item = begin; item != middle; item++)
+            bestLeft = merge(bestLeft, item->box);
+        for (BuildItem* item = middle; item != end; item++)
+            bestRight = merge(bestRight, item->box);
+    }
+    else
+        return false;
+
+    uint32_t leftCount = (uint32_t)(middle - begin);
+    uint32_t child = (uint32_t)nodes.size();
+    nodes.push_back({ bestLeft, 0, node.first, leftCount });
+    nodes.push_back({ bestRight, 0, node.first + leftCount, node.count - leftCount });
+    nodes[nodeIndex].child = child;
+    return true;
+}
+
+void Bvh::refit(const vector<Bounds>& boxes)
+{
+    // children always come after their parent
+    for (size_t i = nodes.size(); i-- > 0;) {
+        Node& node = nodes[i];
+        if (node.child)
+            node.bounds = merge(nodes[node.child].bounds, nodes[node.child + 1].bounds);
+        else
+            node.bounds = rangeBounds(node.first, node.count, boxes);
+    }
+}
+
+size_t Bvh::cullFrustum(const Frustum& frustum, const vector<Bounds>& boxes, vector<uint8_t>& visible) const
+{
+    visible.assign(objects, 0);
+    for (uint32_t object : unbounded)
+        visible[object] = 1;
+    if (nodes.empty())
+        return 0;
+
+    // (node, planes the node isn't known to be inside of yet)
+    vector<pair<uint32_t, uint32_t>> stack;
+    stack.push_back({ 0, (1u << 6) - 1 });
+    size_t visited = 0;
+    while (!stack.empty()) {
+        uint32_t nodeIndex = stack.back().first;
+        uint32_t planeMask = stack.back().second;
+        stack.pop_back();
+        const Node& node = nodes[nodeIndex];
+        visited++;
+        if (!touches(frustum, node.bounds, planeMask))
+            continue;
+
+        if (planeMask == 0) {
+            // inside every plane: the whole range, untested
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                visible[order[i]] = 1;
+        }
+        else if (!node.child) {
+            // a leaf that still straddles a plane: its objects one by one
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                uint32_t objectMask = planeMask;
+                visible[order[i]] = touches(frustum, boxes[order[i]], objectMask);
+            }
+        }
+        else {
+            stack.push_back({ node.child + 1, planeMask });
+            stack.push_back({ node.child, planeMask });
+        }
+    }
+    return visited;
+}
+
+void Bvh::query(const Bounds& box, const vector<Bounds>& boxes, vector<uint32_t>& hits) const
+{
+    if (nodes.empty())
+        return;
+    vector<uint32_t> stack = { 0 };
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(node.bounds, box))
+            continue;
+        if (node.child) {
+            stack.push_back(node.child + 1);
+            stack.push_back(node.child);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            if (overlaps(boxes[order[i]], box))
+                hits.push_back(order[i]);
+        }
+    }
+}
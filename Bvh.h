@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Bounds.h"
+
+struct Frustum;
+
+// bounding volume hierarchy over a set of boxes (a scene's world bounds,
+// indexed like the scene's dense arrays)
+// build() splits by a binned surface area heuristic; refit() keeps the tree
+// and recomputes its boxes bottom up, for objects that moved but didn't
+// teleport. nodes sit in one array with both children of a node next to
+// each other, after their parent; every node owns a contiguous range of
+// the object order, so a subtree is a range
+class Bvh
+{
+public:
+    struct Node {
+        Bounds bounds;
+        // first child, the second is child + 1; 0 for a leaf
+        uint32_t child;
+        // range of the subtree in the object order
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // leaves are split until they hold at most this many objects (when a split pays off)
+    static const uint32_t kMaxLeafObjects = 4;
+    // SAH candidates per axis
+    static const int kBins = 12;
+
+    Bvh();
+
+    // boxes that aren't valid() are kept out of the tree and treated as
+    // visible by cullFrustum(); index i of the boxes is object i
+    void build(const std::vector<Bounds>& boxes);
+    // new boxes for the objects of the last build(), same count
+    void refit(const std::vector<Bounds>& boxes);
+    void clear();
+
+    size_t objectCount() const { return objects; }
+    const std::vector<Node>& getNodes() const { return nodes; }
+
+    // visible[i] = 1 for the objects touching the frustum, 0 for the rest;
+    // subtrees completely inside skip the tests below them; boxes are the
+    // ones the tree was built / refit with; returns the number of nodes visited
+    size_t cullFrustum(const Frustum& frustum, const std::vector<Bounds>& boxes, std::vector<uint8_t>& visible) const;
+    // objects whose box overlaps the query box, appended to hits
+    void query(const Bounds& box, const std::vector<Bounds>& boxes, std::vector<uint32_t>& hits) const;
+
+private:
+    // an object during build(), kept together so partitioning moves it in one piece
+    struct BuildItem {
+        Bounds box;
+        glm::vec3 center;
+        uint32_t object;
+    };
+
+    // split a leaf in two when the SAH says so; the children still have to be split
+    bool split(uint32_t nodeIndex, std::vector<BuildItem>& items);
+    Bounds rangeBounds(uint32_t first, uint32_t count, const std::vector<Bounds>& boxes) const;
+
+    std::vector<Node> nodes;
+    // object indices, permuted so every node's objects are contiguous
+    std::vector<uint32_t> order;
+    // objects without bounds
+    std::vector<uint32_t> unbounded;
+    size_t objects;
+};
@@ -0,0 +1,38 @@
+#include "FrameUniforms.h"
+
+#include <algorithm>
+
+using namespace std;
+
+FrameUniforms::FrameUniforms()
+    : block(ShaderInterface::Binding::FrameData)
+{
+    block.data.view = block.data.projection = block.data.viewProj = glm::mat4(1.f);
+}
+
+void FrameUniforms::setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos)
+{
+    ShaderInterface::FrameData& frame = block.data;
+    frame.view = view;
+    frame.projection = projection;
+    frame.viewProj = projection * view;
+    frame.cameraPos = glm::vec4(cameraPos, 1.f);
+}
+
+void FrameUniforms::setLights(const Light* lights, int count)
+{
+    ShaderInterface::FrameData& frame = block.data;
+    count = max(0, min(count, kMaxLights));
+    for (int i = 0; i < kMaxLights; i++) {
+        if (i < count)
+            frame.lights[i] = lights[i];
+        else
+            frame.lights[i].position = frame.lights[i].color = glm::vec4(0.f);
+    }
+    frame.lightCount = count;
+}
+
+void FrameUniforms::setAmbient(const glm::vec3& color, float strength)
+{
+    block.data.ambient = glm::vec4(color, strength);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "ShaderInterface.h"
+#include "UniformBlock.h"
+
+// per-frame camera and lighting data shared by every program
+// the FrameData block stays bound at its generated binding point; programs
+// only need their block pointed at it (ShaderBuildQueue does that on link)
+class FrameUniforms
+{
+public:
+    typedef ShaderInterface::Light Light;
+
+    static constexpr int kMaxLights = sizeof(ShaderInterface::FrameData::lights) / sizeof(Light);
+
+    FrameUniforms();
+
+    // fill in the camera; viewProj is derived from the two
+    void setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos);
+    // replace the light set, extra lights past kMaxLights are dropped
+    void setLights(const Light* lights, int count);
+    void setAmbient(const glm::vec3& color, float strength);
+
+    // upload the block if anything changed since last frame; call once per frame
+    void upload() { block.upload(); }
+
+    const ShaderInterface::FrameData& data() const { return block.data; }
+    // uploads skipped because the block was unchanged
+    unsigned int skippedUploads() const { return block.skippedUploads(); }
+
+    void release() { block.release(); }
+
+private:
+    UniformBlock<ShaderInterface::FrameData> block;
+};
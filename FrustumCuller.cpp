@@ -0,0 +1,153 @@
+#include "FrustumCuller.h"
+#include "Scene.h"
+#include "WorkerPool.h"
+#include "Bvh.h"
+
+#include <atomic>
+#include <xmmintrin.h>
+
+using namespace std;
+
+namespace {
+    // objects per cull() chunk on the pool
+    const size_t kCullGrain = 4096;
+
+    glm::vec4 normalizePlane(const glm::vec4& plane)
+    {
+        return plane / glm::length(glm::vec3(plane));
+    }
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+{
+    // glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = normalizePlane(rows[3] + rows[0]); // left
+    frustum.planes[1] = normalizePlane(rows[3] - rows[0]); // right
+    frustum.planes[2] = normalizePlane(rows[3] + rows[1]); // bottom
+    frustum.planes[3] = normalizePlane(rows[3] - rows[1]); // top
+    frustum.planes[4] = normalizePlane(rows[3] + rows[2]); // near
+    frustum.planes[5] = normalizePlane(rows[3] - rows[2]); // far
+    return frustum;
+}
+
+bool Frustum::intersects(const Bounds& bounds) const
+{
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+    for (const glm::vec4& plane : planes) {
+        // distance of the center, plus how far the box reaches towards the plane
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = fabs(plane.x) * extent.x + fabs(plane.y) * extent.y + fabs(plane.z) * extent.z;
+        if (distance + radius < 0.f)
+            return false;
+    }
+    return true;
+}
+
+FrustumCuller::FrustumCuller()
+    : stats{ 0, 0, 0, 0 }
+{
+    planes = Frustum::fromMatrix(glm::mat4(1.f));
+}
+
+void FrustumCuller::setViewProjection(const glm::mat4& viewProjection)
+{
+    planes = Frustum::fromMatrix(viewProjection);
+}
+
+void FrustumCuller::cull(const Scene& scene, WorkerPool* pool)
+{
+    visibility.assign(scene.size(), 0);
+    atomic<unsigned int> tested(0), drawn(0);
+    auto job = [&](size_t begin, size_t end) {
+        unsigned int rangeTested = 0, rangeDrawn = 0;
+        cullRange(scene, begin, end, rangeTested, rangeDrawn);
+        tested += rangeTested;
+        drawn += rangeDrawn;
+    };
+    if (pool)
+        pool->parallelFor(scene.size(), kCullGrain, job);
+    else
+        job(0, scene.size());
+
+    stats.tested = tested;
+    stats.drawn = drawn;
+    stats.culled = stats.tested - stats.drawn;
+    stats.nodesVisited = 0;
+}
+
+void FrustumCuller::cull(const Scene& scene, const Bvh& bvh)
+{
+    stats.nodesVisited = (unsigned int)bvh.cullFrustum(planes, scene.worldBounds(), visibility);
+    stats.tested = stats.drawn = 0;
+    const vector<Scene::Renderable>& renderables = scene.renderables();
+    for (size_t i = 0; i < visibility.size(); i++) {
+        if (renderables[i].count == 0) {
+            visibility[i] = 0;
+            continue;
+        }
+        stats.tested++;
+        stats.drawn += visibility[i];
+    }
+    stats.culled = stats.tested - stats.drawn;
+}
+
+void FrustumCuller::cullRange(const Scene& scene, size_t begin, size_t end, unsigned int& tested, unsigned int& drawn)
+{
+    const Bounds* boxes = scene.worldBounds().data();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signMask = _mm_set1_ps(-0.f);
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        const Bounds* box = boxes + i;
+        __m128 minX = _mm_setr_ps(box[0].min.x, box[1].min.x, box[2].min.x, box[3].min.x);
+        __m128 minY = _mm_setr_ps(box[0].min.y, box[1].min.y, box[2].min.y, box[3].min.y);
+        __m128 minZ = _mm_setr_ps(box[0].min.z, box[1].min.z, box[2].min.z, box[3].min.z);
+        __m128 maxX = _mm_setr_ps(box[0].max.x, box[1].max.x, box[2].max.x, box[3].max.x);
+        __m128 maxY = _mm_setr_ps(box[0].max.y, box[1].max.y, box[2].max.y, box[3].max.y);
+        __m128 maxZ = _mm_setr_ps(box[0].max.z, box[1].max.z, box[2].max.z, box[3].max.z);
+        __m128 centerX = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        __m128 centerY = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        __m128 centerZ = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        __m128 extentX = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        __m128 extentY = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        __m128 extentZ = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+        // empty bounds (min > max) mean unknown, never culled
+        __m128 unknown = _mm_or_ps(_mm_cmpgt_ps(minX, maxX), _mm_or_ps(_mm_cmpgt_ps(minY, maxY), _mm_cmpgt_ps(minZ, maxZ)));
+
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : planes.planes) {
+            __m128 normalX = _mm_set1_ps(plane.x);
+            __m128 normalY = _mm_set1_ps(plane.y);
+            __m128 normalZ = _mm_set1_ps(plane.z);
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centerX), _mm_mul_ps(normalY, centerY)),
+                _mm_add_ps(_mm_mul_ps(normalZ, centerZ), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentX),
+                _mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentY)), _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+        int visibleBits = ~_mm_movemask_ps(outside) | _mm_movemask_ps(unknown);
+        for (int lane = 0; lane < 4; lane++)
+            visibility[i + lane] = (visibleBits >> lane) & 1;
+    }
+    for (; i < end; i++)
+        visibility[i] = !boxes[i].valid() || planes.intersects(boxes[i]);
+
+    // only what has something to draw counts
+    const vector<Scene::Renderable>& renderables = scene.renderables();
+    for (i = begin; i < end; i++) {
+        if (renderables[i].count == 0) {
+            visibility[i] = 0;
+            continue;
+        }
+        tested++;
+        drawn += visibility[i];
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+class Scene;
+class WorkerPool;
+class Bvh;
+
+// six planes of a view-projection matrix, normals pointing inwards
+struct Frustum {
+    // (normal, distance): a point p is inside when dot(normal, p) + distance >= 0
+    glm::vec4 planes[6];
+
+    // Gribb / Hartmann: the planes are sums / differences of the matrix rows
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+    // false only if the box is completely outside one of the planes
+    bool intersects(const Bounds& bounds) const;
+};
+
+// per-frame visibility of a scene's objects against the camera frustum
+// world bounds are tested four per SSE step, or walked through a Bvh of
+// them for large scenes; objects without bounds are always visible and
+// objects with nothing to draw are skipped
+class FrustumCuller
+{
+public:
+    struct Stats {
+        // objects with a renderable
+        unsigned int tested;
+        unsigned int culled;
+        unsigned int drawn;
+        // nodes the Bvh walk visited, 0 for the linear test
+        unsigned int nodesVisited;
+    };
+
+    FrustumCuller();
+
+    // planes for the next cull()
+    void setViewProjection(const glm::mat4& viewProjection);
+    const Frustum& frustum() const { return planes; }
+
+    // visible()[i] for every dense object i of the scene
+    void cull(const Scene& scene, WorkerPool* pool = nullptr);
+    // same through a Bvh built / refit from scene.worldBounds()
+    void cull(const Scene& scene, const Bvh& bvh);
+    const std::vector<uint8_t>& visible() const { return visibility; }
+    // counters of the last cull()
+    const Stats& getStats() const { return stats; }
+
+private:
+    // fills visibility[begin, end), adds to the counters
+    void cullRange(const Scene& scene, size_t begin, size_t end, unsigned int& tested, unsigned int& drawn);
+
+    Frustum planes;
+    std::vector<uint8_t> visibility;
+    Stats stats;
+};
@@ -0,0 +1,159 @@
+#include "GLState.h"
+
+using namespace std;
+
+namespace {
+    int targetIndex(GLenum target)
+    {
+        switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_CUBE_MAP: return 1;
+        case GL_TEXTURE_2D_ARRAY: return 2;
+        default: return -1;
+        }
+    }
+}
+
+GLState::GLState()
+{
+    thisFrame = { 0, 0 };
+    lastFrame = { 0, 0 };
+    invalidate();
+}
+
+bool GLState::filter(bool redundant)
+{
+    if (redundant)
+        thisFrame.filtered++;
+    else
+        thisFrame.issued++;
+    return redundant;
+}
+
+void GLState::useProgram(GLuint newProgram)
+{
+    if (filter(program == newProgram))
+        return;
+    program = newProgram;
+    glUseProgram(newProgram);
+}
+
+void GLState::bindVertexArray(GLuint newVao)
+{
+    if (filter(vao == newVao))
+        return;
+    vao = newVao;
+    glBindVertexArray(newVao);
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture)
+{
+    int index = targetIndex(target);
+    bool shadowed = unit >= 0 && unit < kMaxUnits && index >= 0;
+    if (shadowed && filter(textures[unit][index] == texture))
+        return;
+
+    if (activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        thisFrame.issued++;
+    }
+    glBindTexture(target, texture);
+    if (shadowed)
+        textures[unit][index] = texture;
+    else
+        thisFrame.issued++;
+}
+
+void GLState::setEnabled(GLenum cap, int& shadow, bool enabled)
+{
+    int value = enabled ? ON : OFF;
+    if (filter(shadow == value))
+        return;
+    shadow = value;
+    if (enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+}
+
+void GLState::depthTest(bool enabled)
+{
+    setEnabled(GL_DEPTH_TEST, depthTestOn, enabled);
+}
+
+void GLState::depthMask(bool write)
+{
+    int value = write ? ON : OFF;
+    if (filter(depthWrite == value))
+        return;
+    depthWrite = value;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::depthFunc(GLenum func)
+{
+    if (filter(depth == func))
+        return;
+    depth = func;
+    glDepthFunc(func);
+}
+
+void GLState::blend(bool enabled)
+{
+    setEnabled(GL_BLEND, blendOn, enabled);
+}
+
+void GLState::blendFunc(GLenum src, GLenum dst)
+{
+    if (filter(blendSrc == src && blendDst == dst))
+        return;
+    blendSrc = src;
+    blendDst = dst;
+    glBlendFunc(src, dst);
+}
+
+void GLState::cullFace(bool enabled)
+{
+    setEnabled(GL_CULL_FACE, cullOn, enabled);
+}
+
+void GLState::cullMode(GLenum face)
+{
+    if (filter(cull == face))
+        return;
+    cull = face;
+    glCullFace(face);
+}
+
+void GLState::invalidate()
+{
+    program = kUnknown;
+    vao = kUnknown;
+    activeUnit = -1;
+    for (int unit = 0; unit < kMaxUnits; unit++) {
+        for (int target = 0; target < kTargetCount; target++)
+            textures[unit][target] = kUnknown;
+    }
+    depthTestOn = depthWrite = blendOn = cullOn = UNKNOWN;
+    // no valid depth func, blend factor or cull face either
+    depth = blendSrc = blendDst = cull = kUnknown;
+}
+
+void GLState::invalidateActiveUnit()
+{
+    for (int unit = 0; unit < kMaxUnits; unit++) {
+        // with the active unit unknown the bind could have hit any of them
+        if (activeUnit >= 0 && unit != activeUnit)
+            continue;
+        for (int target = 0; target < kTargetCount; target++)
+            textures[unit][target] = kUnknown;
+    }
+}
+
+void GLState::endFrame()
+{
+    lastFrame = thisFrame;
+    thisFrame.issued = 0;
+    thisFrame.filtered = 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// shadow of the GL state the render loop sets every draw: program, VAO,
+// texture units, depth, blend and cull state; a call that wouldn't change
+// anything doesn't reach the driver
+// the cache starts out knowing nothing, so the first call of each kind is
+// always issued; code that sets any of this state directly (texture uploads
+// bind on the active unit) has to tell the cache with invalidate*()
+class GLState
+{
+public:
+    struct Stats {
+        // GL calls issued / dropped because the state was already set
+        unsigned int issued;
+        unsigned int filtered;
+    };
+
+    // units shadowed; binds on higher units go straight through
+    static const int kMaxUnits = 16;
+
+    GLState();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    // selects the unit with glActiveTexture only if the binding changes
+    void bindTexture(int unit, GLenum target, GLuint texture);
+
+    void depthTest(bool enabled);
+    void depthMask(bool write);
+    void depthFunc(GLenum func);
+    void blend(bool enabled);
+    void blendFunc(GLenum src, GLenum dst);
+    void cullFace(bool enabled);
+    void cullMode(GLenum face);
+
+    // forget everything, e.g. after code that doesn't go through the cache
+    void invalidate();
+    // forget the bindings of the active unit (something bound a texture to upload to it)
+    void invalidateActiveUnit();
+
+    // counters of the last finished frame; endFrame() rolls them over
+    const Stats& frameStats() const { return lastFrame; }
+    void endFrame();
+
+private:
+    // 2D, cube map, 2D array; other targets aren't shadowed
+    static const int kTargetCount = 3;
+    // no GL object has this name, marks state the cache doesn't know
+    static const GLuint kUnknown = ~0u;
+    // tri-state for the enables
+    enum Known { UNKNOWN = -1, OFF = 0, ON = 1 };
+
+    bool filter(bool redundant);
+    void setEnabled(GLenum cap, int& shadow, bool enabled);
+
+    GLuint program;
+    GLuint vao;
+    int activeUnit;
+    GLuint textures[kMaxUnits][kTargetCount];
+    int depthTestOn, depthWrite, blendOn, cullOn;
+    GLenum depth, blendSrc, blendDst, cull;
+
+    Stats thisFrame;
+    Stats lastFrame;
+};
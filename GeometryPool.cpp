@@ -0,0 +1,225 @@
+#include "GeometryPool.h"
+#include "ShaderInterface.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+using namespace ShaderInterface;
+
+GeometryPool::GeometryPool(GLsizei vertexCapacity, GLsizei indexCapacity)
+    : vertexCapacity(vertexCapacity), indexCapacity(indexCapacity), defragmentations(0), bytesMoved(0)
+{
+    resetHoles(vertexHoles, 0, vertexCapacity);
+    resetHoles(indexHoles, 0, indexCapacity);
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    GLsizei stride = kFloatsPerVertex * sizeof(float);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+
+    // position, normal, uv, tangent, bitangent
+    glVertexAttribPointer(Sample::Attrib::aPos, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glVertexAttribPointer(Sample::Attrib::vertexNormal, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+    glVertexAttribPointer(Sample::Attrib::aTex, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+    glVertexAttribPointer(Sample::Attrib::m_tan, 3, GL_FLOAT, GL_FALSE, stride, (void*)(8 * sizeof(float)));
+    glVertexAttribPointer(Sample::Attrib::m_btan, 3, GL_FLOAT, GL_FALSE, stride, (void*)(11 * sizeof(float)));
+    glEnableVertexAttribArray(Sample::Attrib::aPos);
+    glEnableVertexAttribArray(Sample::Attrib::vertexNormal);
+    glEnableVertexAttribArray(Sample::Attrib::aTex);
+    glEnableVertexAttribArray(Sample::Attrib::m_tan);
+    glEnableVertexAttribArray(Sample::Attrib::m_btan);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryPool::resetHoles(FreeList& list, GLint start, GLsizei capacity)
+{
+    list.holes.clear();
+    list.available = 0;
+    if (start < capacity)
+        giveHole(list, start, capacity - start);
+}
+
+GLint GeometryPool::takeHole(FreeList& list, GLsizei size)
+{
+    for (auto it = list.holes.begin(); it != list.holes.end(); ++it) {
+        if (it->second < size)
+            continue;
+        GLint offset = it->first;
+        GLsizei rest = it->second - size;
+        list.holes.erase(it);
+        if (rest > 0)
+            list.holes[offset + size] = rest;
+        list.available -= size;
+        return offset;
+    }
+    return -1;
+}
+
+void GeometryPool::giveHole(FreeList& list, GLint offset, GLsizei size)
+{
+    list.available += size;
+    auto next = list.holes.lower_bound(offset);
+    if (next != list.holes.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            list.holes.erase(previous);
+        }
+    }
+    if (next != list.holes.end() && offset + size == next->first) {
+        size += next->second;
+        list.holes.erase(next);
+    }
+    list.holes[offset] = size;
+}
+
+GLsizei GeometryPool::largestHole(const FreeList& list)
+{
+    GLsizei largest = 0;
+    for (const pair<const GLint, GLsizei>& hole : list.holes)
+        largest = max(largest, hole.second);
+    return largest;
+}
+
+GeometryPool::Handle GeometryPool::allocate(const float* vertexData, GLsizei vertexCount, const GLuint* indexData, GLsizei indexCount)
+{
+    if (vertexCount <= 0 || vertexCount > vertexHoles.available || indexCount > indexHoles.available)
+        return kInvalid;
+
+    GLint baseVertex = takeHole(vertexHoles, vertexCount);
+    GLint firstIndex = indexCount > 0 ? takeHole(indexHoles, indexCount) : 0;
+    if (baseVertex < 0 || firstIndex < 0) {
+        // enough space, just not in one piece
+        if (baseVertex >= 0)
+            giveHole(vertexHoles, baseVertex, vertexCount);
+        if (firstIndex >= 0 && indexCount > 0)
+            giveHole(indexHoles, firstIndex, indexCount);
+        defragment();
+        baseVertex = takeHole(vertexHoles, vertexCount);
+        firstIndex = indexCount > 0 ? takeHole(indexHoles, indexCount) : 0;
+    }
+
+    // the copy targets, so neither the VAO's element buffer nor the array
+    // buffer binding of whoever calls this changes
+    GLsizei stride = kFloatsPerVertex * sizeof(float);
+    if (vertexData) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)baseVertex * stride, (GLsizeiptr)vertexCount * stride, vertexData);
+    }
+    if (indexData && indexCount > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indexData);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    Handle handle;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+    }
+    else {
+        handle = (Handle)allocations.size();
+        allocations.emplace_back();
+    }
+    allocations[handle].range = { baseVertex, vertexCount, firstIndex, indexCount };
+    allocations[handle].live = true;
+    return handle;
+}
+
+void GeometryPool::free(Handle handle)
+{
+    if (handle >= allocations.size() || !allocations[handle].live)
+        return;
+    const Range& range = allocations[handle].range;
+    giveHole(vertexHoles, range.baseVertex, range.vertexCount);
+    if (range.indexCount > 0)
+        giveHole(indexHoles, range.firstIndex, range.indexCount);
+    allocations[handle].live = false;
+    freeHandles.push_back(handle);
+}
+
+GLsizei GeometryPool::compact(GLuint buffer, size_t elementBytes, bool vertices)
+{
+    vector<Handle> order;
+    for (Handle handle = 0; handle < allocations.size(); handle++) {
+        const Allocation& allocation = allocations[handle];
+        if (allocation.live && (vertices || allocation.range.indexCount > 0))
+            order.push_back(handle);
+    }
+    sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+        const Range& ra = allocations[a].range;
+        const Range& rb = allocations[b].range;
+        return vertices ? ra.baseVertex < rb.baseVertex : ra.firstIndex < rb.firstIndex;
+    });
+
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    GLsizei end = 0;
+    for (Handle handle : order) {
+        Range& range = allocations[handle].range;
+        GLint& offset = vertices ? range.baseVertex : range.firstIndex;
+        GLsizei count = vertices ? range.vertexCount : range.indexCount;
+        if (offset != end) {
+            // a copy within one buffer can't overlap itself; pieces no longer
+            // than the gap never do, and each lands where the last was read
+            GLsizei gap = offset - end;
+            for (GLsizei done = 0; done < count; done += gap) {
+                GLsizei piece = min(gap, count - done);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)(offset + done) * elementBytes,
+                    (GLintptr)(end + done) * elementBytes, (GLsizeiptr)piece * elementBytes);
+            }
+            bytesMoved += (size_t)count * elementBytes;
+            offset = end;
+        }
+        end += count;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return end;
+}
+
+void GeometryPool::defragment()
+{
+    bytesMoved = 0;
+    GLsizei vertexEnd = compact(vertexBuffer, kFloatsPerVertex * sizeof(float), true);
+    GLsizei indexEnd = compact(indexBuffer, sizeof(GLuint), false);
+    resetHoles(vertexHoles, vertexEnd, vertexCapacity);
+    resetHoles(indexHoles, indexEnd, indexCapacity);
+    defragmentations++;
+}
+
+GeometryPool::Stats GeometryPool::getStats() const
+{
+    Stats stats;
+    stats.vertexCapacity = vertexCapacity;
+    stats.verticesUsed = vertexCapacity - vertexHoles.available;
+    stats.indexCapacity = indexCapacity;
+    stats.indicesUsed = indexCapacity - indexHoles.available;
+    stats.allocations = (unsigned int)(allocations.size() - freeHandles.size());
+    stats.freeBlocks = (unsigned int)(vertexHoles.holes.size() + indexHoles.holes.size());
+    stats.largestFreeVertices = largestHole(vertexHoles);
+    stats.largestFreeIndices = largestHole(indexHoles);
+    stats.defragmentations = defragmentations;
+    stats.bytesMoved = bytesMoved;
+    return stats;
+}
+
+void GeometryPool::release()
+{
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    vertexArray = vertexBuffer = indexBuffer = 0;
+    allocations.clear();
+    freeHandles.clear();
+    resetHoles(vertexHoles, 0, vertexCapacity);
+    resetHoles(indexHoles, 0, indexCapacity);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+// vertices and indices of many meshes in one vertex and one index buffer,
+// read through one VAO, so draws of different meshes don't switch VAOs
+// the buffers are sized once; ranges are handed out first fit from a free
+// list per buffer that merges neighbours when a range comes back, so
+// loading and unloading never reallocates GL storage. indices stay relative
+// to their mesh and are drawn with its base vertex, so defragment() can
+// slide the ranges together without touching the index data
+class GeometryPool
+{
+public:
+    typedef uint32_t Handle;
+    static const Handle kInvalid = ~0u;
+    // the sample program's vertex layout, as Mesh
+    static const int kFloatsPerVertex = 14;
+
+    // where a mesh lives in the buffers, in vertices / indices
+    struct Range {
+        GLint baseVertex;
+        GLsizei vertexCount;
+        GLint firstIndex;
+        GLsizei indexCount;
+    };
+
+    struct Stats {
+        GLsizei vertexCapacity;
+        GLsizei verticesUsed;
+        GLsizei indexCapacity;
+        GLsizei indicesUsed;
+        unsigned int allocations;
+        // holes in both buffers, and the biggest of each
+        unsigned int freeBlocks;
+        GLsizei largestFreeVertices;
+        GLsizei largestFreeIndices;
+        unsigned int defragmentations;
+        // bytes the last defragment() copied
+        size_t bytesMoved;
+    };
+
+    GeometryPool(GLsizei vertexCapacity, GLsizei indexCapacity);
+
+    // copies the vertices (kFloatsPerVertex floats each) and indices in, or
+    // just reserves the space when the data is null; no indices for a
+    // glDrawArrays mesh. defragments when no hole is big enough but the free
+    // space in total is; kInvalid when even that doesn't help
+    Handle allocate(const float* vertexData, GLsizei vertexCount, const GLuint* indexData, GLsizei indexCount);
+    void free(Handle handle);
+    // moves with defragment(), so draws read it again rather than keep a copy
+    const Range& range(Handle handle) const { return allocations[handle].range; }
+
+    GLuint vao() const { return vertexArray; }
+
+    // packs the live ranges at the front of both buffers, in their order
+    void defragment();
+
+    Stats getStats() const;
+
+    void release();
+
+private:
+    // free ranges of one buffer, offset -> size, in elements
+    struct FreeList {
+        std::map<GLint, GLsizei> holes;
+        GLsizei available;
+    };
+
+    struct Allocation {
+        Range range;
+        bool live;
+    };
+
+    // everything from start up to capacity free
+    static void resetHoles(FreeList& list, GLint start, GLsizei capacity);
+    // offset of the first hole that fits, -1 if none does
+    static GLint takeHole(FreeList& list, GLsizei size);
+    // merged with the holes on either side
+    static void giveHole(FreeList& list, GLint offset, GLsizei size);
+    static GLsizei largestHole(const FreeList& list);
+
+    // slides the live vertex (or index) ranges of one buffer down to the
+    // front, in offset order; returns where the packed data ends
+    GLsizei compact(GLuint buffer, size_t elementBytes, bool vertices);
+
+    GLuint vertexArray;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLsizei vertexCapacity;
+    GLsizei indexCapacity;
+    FreeList vertexHoles;
+    FreeList indexHoles;
+    // by handle; dead slots are reused first
+    std::vector<Allocation> allocations;
+    std::vector<Handle> freeHandles;
+    unsigned int defragmentations;
+    size_t bytesMoved;
+};
@@ -0,0 +1,121 @@
+#include "GpuCuller.h"
+#include "Scene.h"
+#include "GLState.h"
+#include "UniformTable.h"
+#include "ShaderInterface.h"
+
+using namespace std;
+using namespace ShaderInterface;
+
+namespace {
+    // DrawElementsIndirectCommand
+    const size_t kCommandBytes = 5 * sizeof(GLuint);
+}
+
+GpuCuller::GpuCuller()
+    : boundsBuffer(0), commandBuffer(0), countBuffer(0), objects(0), drawCount(false)
+{
+    if (!supported())
+        return;
+    drawCount = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_indirect_parameters;
+    glGenBuffers(1, &boundsBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &countBuffer);
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+bool GpuCuller::supported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void GpuCuller::upload(const Scene& scene, InstanceBuffer& instances)
+{
+    objects = scene.size();
+    const vector<Bounds>& boxes = scene.worldBounds();
+    const vector<glm::mat4>& worlds = scene.worldMatrices();
+
+    staging.resize(objects);
+    vector<glm::vec4> bounds(objects * 2);
+    for (size_t i = 0; i < objects; i++) {
+        staging[i] = { worlds[i], glm::vec4(1.f) };
+        bounds[i * 2] = glm::vec4(boxes[i].min, 0.f);
+        bounds[i * 2 + 1] = glm::vec4(boxes[i].max, 0.f);
+    }
+    instances.upload(staging);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, objects * kCommandBytes, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::cull(GLState& state, GLuint program, UniformTable& uniforms, GLsizei indexCount, GLint firstIndex, GLint baseVertex)
+{
+    if (!objects)
+        return;
+    if (drawCount) {
+        GLuint zero = 0;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    state.useProgram(program);
+    uniforms.bind(program);
+    uniforms.set(Cull::Uniform::objectCount, (unsigned int)objects);
+    uniforms.set(Cull::Uniform::indexCount, (unsigned int)indexCount);
+    uniforms.set(Cull::Uniform::firstIndex, (unsigned int)firstIndex);
+    uniforms.set(Cull::Uniform::baseVertex, baseVertex);
+    uniforms.set(Cull::Uniform::compact, drawCount ? 1u : 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBoundsBinding, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCommandsBinding, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kCountBinding, countBuffer);
+    glDispatchCompute((GLuint)((objects + kGroupSize - 1) / kGroupSize), 1, 1);
+    // the draw reads the commands (and their count) as indirect parameters
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void GpuCuller::draw()
+{
+    if (!objects)
+        return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (drawCount) {
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+        if (GLAD_GL_VERSION_4_6)
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, (GLsizei)objects, 0);
+        else
+            glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, (GLsizei)objects, 0);
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    }
+    else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei)objects, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+unsigned int GpuCuller::readDrawCount()
+{
+    if (!drawCount)
+        return 0;
+    GLuint count = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
+
+void GpuCuller::release()
+{
+    glDeleteBuffers(1, &boundsBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &countBuffer);
+    boundsBuffer = commandBuffer = countBuffer = 0;
+    objects = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+#include "InstanceBuffer.h"
+
+class Scene;
+class GLState;
+class UniformTable;
+
+// GPU-driven culling for many objects sharing one indexed mesh
+// upload() puts every object's world box into a storage buffer and its
+// world matrix into the instance buffer attached to the mesh's VAO; after
+// that a frame costs the CPU one dispatch and one draw whatever the object
+// count: the cull compute program tests the boxes against FrameData's
+// frustum and writes a DrawElementsIndirectCommand per visible object,
+// with baseInstance picking the object's matrix, and draw() submits them
+// all with one multi draw. With GL 4.6 / ARB_indirect_parameters the
+// commands are packed and the draw reads their count from the GPU;
+// otherwise every object keeps its command slot, culled ones with an
+// instance count of 0. Needs GL 4.3 (compute, storage buffers, multi draw
+// indirect); without it callers stay on FrustumCuller
+class GpuCuller
+{
+public:
+    // storage buffer bindings of cull.comp
+    static const GLuint kBoundsBinding = 0;
+    static const GLuint kCommandsBinding = 1;
+    static const GLuint kCountBinding = 2;
+    // cull.comp's local_size_x
+    static const GLuint kGroupSize = 64;
+
+    GpuCuller();
+
+    static bool supported();
+    // whether draw() reads a packed count off the GPU
+    bool packed() const { return drawCount; }
+
+    // the scene's world bounds and matrices, every object drawn with the
+    // mesh the instances buffer is attached to; again whenever they changed
+    void upload(const Scene& scene, InstanceBuffer& instances);
+    size_t objectCount() const { return objects; }
+
+    // writes the commands for indexCount indices per object, starting at
+    // firstIndex with baseVertex (a mesh in a GeometryPool); program is the
+    // linked cull compute program, FrameData has to be uploaded already
+    void cull(GLState& state, GLuint program, UniformTable& uniforms, GLsizei indexCount, GLint firstIndex = 0, GLint baseVertex = 0);
+    // the commands of the last cull(), with the mesh's VAO and an INSTANCED
+    // sample variant bound (ObjectData.transform identity)
+    void draw();
+
+    // commands the last packed cull() wrote; waits for the GPU, for stats only
+    unsigned int readDrawCount();
+
+    void release();
+
+private:
+    GLuint boundsBuffer;
+    GLuint commandBuffer;
+    GLuint countBuffer;
+    size_t objects;
+    bool drawCount;
+    std::vector<InstanceBuffer::Instance> staging;
+};
@@ -0,0 +1,63 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+    : writeIndex(0), readIndex(0), inFlight(0), open(false), last(0.0), total(0.0), samples(0)
+{
+    glGenQueries(kQueries, queries);
+}
+
+void GpuTimer::begin()
+{
+    // every query busy: the oldest result has to come in before it can be reused
+    if (inFlight == kQueries)
+        readOldest();
+    glBeginQuery(GL_TIME_ELAPSED, queries[writeIndex]);
+    open = true;
+}
+
+void GpuTimer::end()
+{
+    if (!open)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    open = false;
+    writeIndex = (writeIndex + 1) % kQueries;
+    inFlight++;
+}
+
+void GpuTimer::collect(bool wait)
+{
+    while (inFlight > 0) {
+        if (!wait) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(queries[readIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return;
+        }
+        readOldest();
+    }
+}
+
+void GpuTimer::readOldest()
+{
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries[readIndex], GL_QUERY_RESULT, &nanoseconds);
+    last = nanoseconds / 1.0e6;
+    total += last;
+    samples++;
+    readIndex = (readIndex + 1) % kQueries;
+    inFlight--;
+}
+
+void GpuTimer::reset()
+{
+    // results still in flight belong to the old run
+    collect(true);
+    total = 0.0;
+    samples = 0;
+}
+
+void GpuTimer::release()
+{
+    glDeleteQueries(kQueries, queries);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// GPU time of a range of commands, measured with GL_TIME_ELAPSED queries
+// results are picked up a few frames later so timing never stalls the
+// pipeline; ranges of different timers must not nest (GL allows one
+// TIME_ELAPSED query at a time) but can follow each other within a frame
+class GpuTimer
+{
+public:
+    GpuTimer();
+
+    void begin();
+    void end();
+    // pick up finished results; wait = block until every range is in
+    void collect(bool wait = false);
+
+    // milliseconds of the latest finished range, 0 before the first one
+    double lastMs() const { return last; }
+    // average over the finished ranges since the last reset()
+    double averageMs() const { return samples ? total / samples : 0.0; }
+    int sampleCount() const { return samples; }
+    void reset();
+
+    void release();
+
+private:
+    static const int kQueries = 4;
+
+    // blocks until the oldest range in flight is done
+    void readOldest();
+
+    GLuint queries[kQueries];
+    // next query to start, oldest one still in flight
+    int writeIndex, readIndex, inFlight;
+    bool open;
+    double last, total;
+    int samples;
+};
@@ -0,0 +1,51 @@
+#include "InstanceBuffer.h"
+#include "ShaderInterface.h"
+
+#include <cstddef>
+
+using namespace std;
+using namespace ShaderInterface;
+
+InstanceBuffer::InstanceBuffer()
+    : capacity(0), instanceCount(0)
+{
+    glGenBuffers(1, &buffer);
+}
+
+void InstanceBuffer::attach(GLuint vao)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    GLsizei stride = sizeof(Instance);
+    // a mat4 attribute takes four consecutive locations, one per column
+    for (GLuint column = 0; column < 4; column++) {
+        GLuint location = Sample::Attrib::instanceTransform + column;
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offsetof(Instance, transform) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+        glEnableVertexAttribArray(location);
+    }
+    glVertexAttribPointer(Sample::Attrib::instanceColor, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Instance, color));
+    glVertexAttribDivisor(Sample::Attrib::instanceColor, 1);
+    glEnableVertexAttribArray(Sample::Attrib::instanceColor);
+    glBindVertexArray(0);
+}
+
+void InstanceBuffer::upload(const Instance* instances, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    size_t bytes = count * sizeof(Instance);
+    if (bytes > capacity)
+        capacity = bytes;
+    // orphan: the driver hands out fresh storage instead of waiting on the GPU
+    glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+    if (bytes)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    instanceCount = (GLsizei)count;
+}
+
+void InstanceBuffer::release()
+{
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// per-instance data of an instanced draw, read by the INSTANCED variant of
+// the sample program as vertex attributes with a divisor of 1
+class InstanceBuffer
+{
+public:
+    struct Instance {
+        // placed on top of ObjectData.transform; uniform scale only
+        glm::mat4 transform;
+        // multiplied into the albedo
+        glm::vec4 color;
+    };
+
+    InstanceBuffer();
+
+    // point the instance attributes of a VAO (e.g. a Mesh's) at this buffer
+    void attach(GLuint vao);
+    // replace the contents; the storage grows as needed and is orphaned on
+    // every upload so a draw still reading the old data doesn't stall
+    void upload(const Instance* instances, size_t count);
+    void upload(const std::vector<Instance>& instances) { upload(instances.data(), instances.size()); }
+
+    GLsizei count() const { return instanceCount; }
+    void release();
+
+private:
+    GLuint buffer;
+    size_t capacity;
+    GLsizei instanceCount;
+};
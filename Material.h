@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "RenderPass.h"
+
+// feature bits of the sample program, each one is a #define in sample.vert / sample.frag
+enum SampleFeature {
+    FEATURE_NORMAL_MAP = 1 << 0,
+    FEATURE_ALPHA_TEST = 1 << 1,
+    FEATURE_SPECULAR = 1 << 2,
+    // set by the draw, not the material: transforms come from an InstanceBuffer
+    FEATURE_INSTANCED = 1 << 3,
+    // set by the render queue's batches: ObjectData per draw of a multi draw
+    FEATURE_MULTI_DRAW = 1 << 4,
+};
+const int kSampleFeatureCount = 5;
+// #define names of the bits above, in bit order
+const char* const kSampleFeatureNames[kSampleFeatureCount] = { "NORMAL_MAP", "ALPHA_TEST", "SPECULAR", "INSTANCED", "MULTI_DRAW" };
+
+// surface of one drawable; decides which sample variant it is drawn with
+struct Material {
+    GLuint albedo;
+    // 0 = no normal map
+    GLuint normalMap;
+    // the albedo alpha is a cutout mask
+    bool cutout;
+    float specStr;
+    float specPhong;
+    // alpha blended over what is behind it
+    bool blended;
+    // TextureStreamer handles of albedo / normalMap for the feedback pass,
+    // -1 for a texture that isn't streamed
+    int albedoHandle;
+    int normalMapHandle;
+
+    // pass the material is drawn in
+    RenderPass pass() const
+    {
+        if (blended)
+            return PASS_TRANSPARENT;
+        return cutout ? PASS_CUTOUT : PASS_OPAQUE;
+    }
+
+    // cheapest feature set that still renders the material correctly
+    unsigned int features() const
+    {
+        unsigned int bits = 0;
+        if (normalMap)
+            bits |= FEATURE_NORMAL_MAP;
+        if (cutout)
+            bits |= FEATURE_ALPHA_TEST;
+        if (specStr > 0.f)
+            bits |= FEATURE_SPECULAR;
+        return bits;
+    }
+};
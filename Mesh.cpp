@@ -0,0 +1,184 @@
+#include "Mesh.h"
+#include "ShaderInterface.h"
+#include "tiny_obj_loader.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace ShaderInterface;
+
+namespace {
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 uv;
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+    };
+    static_assert(sizeof(Vertex) == Mesh::kFloatsPerVertex * sizeof(float), "vertex layout of the sample program");
+
+    // unit vector perpendicular to n
+    glm::vec3 perpendicular(const glm::vec3& n)
+    {
+        glm::vec3 axis = fabs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+        return glm::normalize(glm::cross(axis, n));
+    }
+}
+
+Mesh::Mesh()
+    : vertexArray(0), vertexBuffer(0), indexBuffer(0), pool(nullptr), handle(GeometryPool::kInvalid), indices(0), vertices(0),
+    box(Bounds::empty())
+{
+}
+
+bool Mesh::load(const string& path, GeometryPool* into)
+{
+    tinyobj::attrib_t attributes;
+    vector<tinyobj::shape_t> shapes;
+    vector<tinyobj::material_t> materials;
+    string warning, error;
+    if (!tinyobj::LoadObj(&attributes, &shapes, &materials, &warning, &error, path.c_str())) {
+        cerr << "can't load " << path << ": " << error << endl;
+        return false;
+    }
+
+    bool hasNormals = !attributes.normals.empty();
+    bool hasUVs = !attributes.texcoords.empty();
+    vector<Vertex> vertexData;
+    vector<GLuint> indexData;
+    // (position, normal, uv) index -> vertex; attributes the file doesn't
+    // have are left out, so those corners are shared by position alone
+    map<tuple<int, int, int>, GLuint> unique;
+    for (const tinyobj::shape_t& shape : shapes) {
+        for (const tinyobj::index_t& index : shape.mesh.indices) {
+            int normalIndex = hasNormals ? index.normal_index : -1;
+            int uvIndex = hasUVs ? index.texcoord_index : -1;
+            tuple<int, int, int> corner(index.vertex_index, normalIndex, uvIndex);
+            auto found = unique.find(corner);
+            if (found != unique.end()) {
+                indexData.push_back(found->second);
+                continue;
+            }
+            Vertex vertex = {};
+            vertex.position = glm::vec3(attributes.vertices[index.vertex_index * 3],
+                attributes.vertices[index.vertex_index * 3 + 1], attributes.vertices[index.vertex_index * 3 + 2]);
+            if (normalIndex >= 0) {
+                vertex.normal = glm::vec3(attributes.normals[normalIndex * 3],
+                    attributes.normals[normalIndex * 3 + 1], attributes.normals[normalIndex * 3 + 2]);
+            }
+            if (uvIndex >= 0)
+                vertex.uv = glm::vec2(attributes.texcoords[uvIndex * 2], attributes.texcoords[uvIndex * 2 + 1]);
+            GLuint id = (GLuint)vertexData.size();
+            unique[corner] = id;
+            vertexData.push_back(vertex);
+            indexData.push_back(id);
+        }
+    }
+
+    // area weighted face normals / uv tangents, summed per vertex
+    for (size_t i = 0; i + 2 < indexData.size(); i += 3) {
+        Vertex& a = vertexData[indexData[i]];
+        Vertex& b = vertexData[indexData[i + 1]];
+        Vertex& c = vertexData[indexData[i + 2]];
+        glm::vec3 edge1 = b.position - a.position;
+        glm::vec3 edge2 = c.position - a.position;
+        if (!hasNormals) {
+            glm::vec3 face = glm::cross(edge1, edge2);
+            a.normal += face;
+            b.normal += face;
+            c.normal += face;
+        }
+        if (hasUVs) {
+            glm::vec2 deltaUV1 = b.uv - a.uv;
+            glm::vec2 deltaUV2 = c.uv - a.uv;
+            float det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+            if (fabs(det) < 1e-12f)
+                continue;
+            float r = 1.0f / det;
+            glm::vec3 tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r;
+            glm::vec3 bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r;
+            for (Vertex* vertex : { &a, &b, &c }) {
+                vertex->tangent += tangent;
+                vertex->bitangent += bitangent;
+            }
+        }
+    }
+    for (Vertex& vertex : vertexData) {
+        float length = glm::length(vertex.normal);
+        vertex.normal = length > 0.f ? vertex.normal / length : glm::vec3(0, 0, 1);
+        if (glm::length(vertex.tangent) > 0.f) {
+            vertex.tangent = glm::normalize(vertex.tangent);
+            vertex.bitangent = glm::length(vertex.bitangent) > 0.f ? glm::normalize(vertex.bitangent) : glm::cross(vertex.normal, vertex.tangent);
+        }
+        else {
+            vertex.tangent = perpendicular(vertex.normal);
+            vertex.bitangent = glm::cross(vertex.normal, vertex.tangent);
+        }
+    }
+
+    release();
+    if (into) {
+        static_assert(GeometryPool::kFloatsPerVertex == kFloatsPerVertex, "pool vertex layout");
+        handle = into->allocate((const float*)vertexData.data(), (GLsizei)vertexData.size(), indexData.data(), (GLsizei)indexData.size());
+        if (handle == GeometryPool::kInvalid) {
+            cerr << "can't load " << path << ": geometry pool is full" << endl;
+            return false;
+        }
+        pool = into;
+    }
+    else {
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexData.size(), indexData.data(), GL_STATIC_DRAW);
+
+        GLsizei stride = sizeof(Vertex);
+        glVertexAttribPointer(Sample::Attrib::aPos, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, position));
+        glVertexAttribPointer(Sample::Attrib::vertexNormal, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, normal));
+        glVertexAttribPointer(Sample::Attrib::aTex, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, uv));
+        glVertexAttribPointer(Sample::Attrib::m_tan, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, tangent));
+        glVertexAttribPointer(Sample::Attrib::m_btan, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, bitangent));
+        glEnableVertexAttribArray(Sample::Attrib::aPos);
+        glEnableVertexAttribArray(Sample::Attrib::vertexNormal);
+        glEnableVertexAttribArray(Sample::Attrib::aTex);
+        glEnableVertexAttribArray(Sample::Attrib::m_tan);
+        glEnableVertexAttribArray(Sample::Attrib::m_btan);
+        glBindVertexArray(0);
+    }
+
+    indices = (GLsizei)indexData.size();
+    vertices = (GLsizei)vertexData.size();
+    box = Bounds::empty();
+    for (const Vertex& vertex : vertexData)
+        box.add(vertex.position);
+    triangleList.clear();
+    for (GLuint index : indexData)
+        triangleList.push_back(vertexData[index].position);
+    return true;
+}
+
+void Mesh::release()
+{
+    if (pool) {
+        pool->free(handle);
+        pool = nullptr;
+        handle = GeometryPool::kInvalid;
+    }
+    if (vertexArray) {
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+        vertexArray = vertexBuffer = indexBuffer = 0;
+    }
+    indices = vertices = 0;
+    box = Bounds::empty();
+}
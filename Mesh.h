@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "Bounds.h"
+#include "GeometryPool.h"
+
+// indexed triangle mesh from an .obj file, in the sample program's vertex
+// layout: position, normal, uv, tangent, bitangent (14 floats)
+// corners sharing position/normal/uv become one vertex; what the file
+// doesn't have is filled in: smooth normals from the faces, uv 0 and a
+// tangent frame from the uvs (or any frame around the normal without them)
+// loaded into a GeometryPool the mesh is a range of the pool's buffers,
+// drawn through the pool's VAO from firstIndex() with baseVertex()
+class Mesh
+{
+public:
+    static const int kFloatsPerVertex = 14;
+
+    Mesh();
+
+    // replaces what was loaded before; false if the file can't be read or
+    // the pool has no room for it. without a pool the mesh has its own buffers
+    bool load(const std::string& path, GeometryPool* pool = nullptr);
+    void release();
+
+    GLuint vao() const { return pool ? pool->vao() : vertexArray; }
+    // 0 with its own buffers; read them at draw time, the pool's defragment() moves them
+    GLint firstIndex() const { return pool ? pool->range(handle).firstIndex : 0; }
+    GLint baseVertex() const { return pool ? pool->range(handle).baseVertex : 0; }
+    GLsizei indexCount() const { return indices; }
+    GLsizei vertexCount() const { return vertices; }
+    // object space box around the positions
+    const Bounds& bounds() const { return box; }
+    // positions of every triangle corner, three per triangle, for CPU users
+    // such as the occlusion rasterizer
+    const std::vector<glm::vec3>& triangles() const { return triangleList; }
+
+private:
+    GLuint vertexArray;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GeometryPool* pool;
+    GeometryPool::Handle handle;
+    GLsizei indices;
+    GLsizei vertices;
+    Bounds box;
+    std::vector<glm::vec3> triangleList;
+};
@@ -0,0 +1,276 @@
+#include "OcclusionCuller.h"
+#include "Scene.h"
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <xmmintrin.h>
+
+using namespace std;
+
+namespace {
+    // rows per rasterize() chunk on the pool
+    const size_t kBandRows = 16;
+    // objects per cull() chunk on the pool
+    const size_t kTestGrain = 1024;
+
+    int levelWidth(int level)
+    {
+        return max(1, OcclusionCuller::kWidth >> level);
+    }
+
+    int levelHeight(int level)
+    {
+        return max(1, OcclusionCuller::kHeight >> level);
+    }
+
+    float millisecondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<float, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+OcclusionCuller::OcclusionCuller()
+    : viewProjection(1.f), stats{ 0, 0, 0, 0, 0.f, 0.f }
+{
+    for (int level = 0; levelWidth(level) > 1 || levelHeight(level) > 1; level++)
+        levels.push_back(vector<float>(levelWidth(level) * levelHeight(level), 1.f));
+    levels.push_back(vector<float>(1, 1.f));
+}
+
+void OcclusionCuller::begin(const glm::mat4& matrix)
+{
+    viewProjection = matrix;
+    triangles.clear();
+    fill(levels[0].begin(), levels[0].end(), 1.f);
+    stats.occluders = 0;
+    stats.triangles = 0;
+}
+
+void OcclusionCuller::addOccluder(const vector<glm::vec3>& positions, const glm::mat4& world)
+{
+    glm::mat4 matrix = viewProjection * world;
+    for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+        addClipTriangle(matrix * glm::vec4(positions[i], 1.f), matrix * glm::vec4(positions[i + 1], 1.f),
+            matrix * glm::vec4(positions[i + 2], 1.f));
+    }
+    stats.occluders++;
+    stats.triangles += (unsigned int)(positions.size() / 3);
+}
+
+void OcclusionCuller::addClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+{
+    // all three outside the same side plane: nothing on screen
+    if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w)
+        || (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w))
+        return;
+
+    // near plane (z + w >= 0 inside) cut: a triangle becomes up to a quad
+    const glm::vec4 corners[3] = { a, b, c };
+    glm::vec4 clipped[4];
+    int count = 0;
+    for (int i = 0; i < 3; i++) {
+        const glm::vec4& current = corners[i];
+        const glm::vec4& next = corners[(i + 1) % 3];
+        float currentDistance = current.z + current.w;
+        float nextDistance = next.z + next.w;
+        if (currentDistance >= 0.f)
+            clipped[count++] = current;
+        if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+            clipped[count++] = current + (next - current) * (currentDistance / (currentDistance - nextDistance));
+    }
+    if (count < 3)
+        return;
+
+    glm::vec3 screen[4];
+    for (int i = 0; i < count; i++) {
+        glm::vec3 ndc = glm::vec3(clipped[i]) / clipped[i].w;
+        screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * kWidth, (ndc.y * 0.5f + 0.5f) * kHeight, ndc.z * 0.5f + 0.5f);
+    }
+    addScreenTriangle(screen[0], screen[1], screen[2]);
+    if (count == 4)
+        addScreenTriangle(screen[0], screen[2], screen[3]);
+}
+
+void OcclusionCuller::addScreenTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (fabs(area) < 1e-8f)
+        return;
+    // occluders are drawn from both sides
+    glm::vec3 corners[3] = { a, b, c };
+    if (area < 0.f) {
+        swap(corners[1], corners[2]);
+        area = -area;
+    }
+
+    Triangle triangle;
+    // pixels whose center is inside the bounding box
+    float minX = min(corners[0].x, min(corners[1].x, corners[2].x));
+    float maxX = max(corners[0].x, max(corners[1].x, corners[2].x));
+    float minY = min(corners[0].y, min(corners[1].y, corners[2].y));
+    float maxY = max(corners[0].y, max(corners[1].y, corners[2].y));
+    triangle.minX = max(0, (int)ceil(minX - 0.5f));
+    triangle.maxX = min(kWidth - 1, (int)floor(maxX - 0.5f));
+    triangle.minY = max(0, (int)ceil(minY - 0.5f));
+    triangle.maxY = min(kHeight - 1, (int)floor(maxY - 0.5f));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return;
+
+    // edge i is the one opposite corner i; divided by the area the edge
+    // functions are the barycentrics, which interpolate the depth
+    triangle.depth = glm::vec3(0.f);
+    for (int i = 0; i < 3; i++) {
+        const glm::vec3& from = corners[(i + 1) % 3];
+        const glm::vec3& to = corners[(i + 2) % 3];
+        triangle.edge[i] = glm::vec3(from.y - to.y, to.x - from.x, (to.y - from.y) * from.x - (to.x - from.x) * from.y);
+        triangle.depth += triangle.edge[i] * (corners[i].z / area);
+    }
+    triangles.push_back(triangle);
+}
+
+void OcclusionCuller::rasterize(WorkerPool* pool)
+{
+    auto start = chrono::steady_clock::now();
+    auto job = [&](size_t begin, size_t end) { rasterizeRows((int)begin, (int)end); };
+    if (pool)
+        pool->parallelFor(kHeight, kBandRows, job);
+    else
+        job(0, kHeight);
+    buildPyramid();
+    stats.rasterizeMs = millisecondsSince(start);
+}
+
+void OcclusionCuller::rasterizeRows(int firstRow, int endRow)
+{
+    float* depthBuffer = levels[0].data();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    for (const Triangle& triangle : triangles) {
+        int y0 = max(triangle.minY, firstRow);
+        int y1 = min(triangle.maxY, endRow - 1);
+        if (y0 > y1)
+            continue;
+        // rows are kWidth floats, a multiple of 4, so a group never runs past the row
+        int x0 = triangle.minX & ~3;
+        __m128 edgeStep[3], edgeX[3];
+        for (int i = 0; i < 3; i++) {
+            edgeX[i] = _mm_set1_ps(triangle.edge[i].x);
+            edgeStep[i] = _mm_set1_ps(triangle.edge[i].x * 4.f);
+        }
+        __m128 depthX = _mm_set1_ps(triangle.depth.x);
+        __m128 depthStep = _mm_set1_ps(triangle.depth.x * 4.f);
+        __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x0), offsets);
+
+        for (int y = y0; y <= y1; y++) {
+            float centerY = y + 0.5f;
+            __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeX[0], centerX), _mm_set1_ps(triangle.edge[0].y * centerY + triangle.edge[0].z));
+            __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeX[1], centerX), _mm_set1_ps(triangle.edge[1].y * centerY + triangle.edge[1].z));
+            __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeX[2], centerX), _mm_set1_ps(triangle.edge[2].y * centerY + triangle.edge[2].z));
+            __m128 depth = _mm_add_ps(_mm_mul_ps(depthX, centerX), _mm_set1_ps(triangle.depth.y * centerY + triangle.depth.z));
+            float* row = depthBuffer + y * kWidth;
+            for (int x = x0; x <= triangle.maxX; x += 4) {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_and_ps(_mm_cmpge_ps(edge1, zero), _mm_cmpge_ps(edge2, zero)));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+                }
+                edge0 = _mm_add_ps(edge0, edgeStep[0]);
+                edge1 = _mm_add_ps(edge1, edgeStep[1]);
+                edge2 = _mm_add_ps(edge2, edgeStep[2]);
+                depth = _mm_add_ps(depth, depthStep);
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    for (int level = 1; level < (int)levels.size(); level++) {
+        const vector<float>& below = levels[level - 1];
+        vector<float>& texels = levels[level];
+        int belowWidth = levelWidth(level - 1), belowHeight = levelHeight(level - 1);
+        int width = levelWidth(level), height = levelHeight(level);
+        for (int y = 0; y < height; y++) {
+            int y0 = min(y * 2, belowHeight - 1), y1 = min(y * 2 + 1, belowHeight - 1);
+            for (int x = 0; x < width; x++) {
+                int x0 = min(x * 2, belowWidth - 1), x1 = min(x * 2 + 1, belowWidth - 1);
+                texels[y * width + x] = max(max(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+                    max(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::occluded(const Bounds& box) const
+{
+    if (!box.valid())
+        return false;
+    glm::vec3 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(point, 1.f);
+        // reaches in front of the near plane: nothing can be in front of it
+        if (clip.w <= 1e-5f || clip.z < -clip.w)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    // off screen is the frustum's call
+    if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f)
+        return false;
+
+    // every pixel the box touches, the nearest depth of the box
+    int x0 = max(0, min(kWidth - 1, (int)floor((ndcMin.x * 0.5f + 0.5f) * kWidth)));
+    int x1 = max(0, min(kWidth - 1, (int)floor((ndcMax.x * 0.5f + 0.5f) * kWidth)));
+    int y0 = max(0, min(kHeight - 1, (int)floor((ndcMin.y * 0.5f + 0.5f) * kHeight)));
+    int y1 = max(0, min(kHeight - 1, (int)floor((ndcMax.y * 0.5f + 0.5f) * kHeight)));
+    float nearest = ndcMin.z * 0.5f + 0.5f;
+
+    int level = 0;
+    while (level + 1 < (int)levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        level++;
+    int width = levelWidth(level), height = levelHeight(level);
+    const vector<float>& texels = levels[level];
+    for (int y = y0 >> level; y <= min(y1 >> level, height - 1); y++) {
+        for (int x = x0 >> level; x <= min(x1 >> level, width - 1); x++) {
+            if (nearest <= texels[y * width + x])
+                return false;
+        }
+    }
+    return true;
+}
+
+void OcclusionCuller::cull(const Scene& scene, const vector<uint8_t>& candidates, WorkerPool* pool)
+{
+    auto start = chrono::steady_clock::now();
+    visibility = candidates;
+    const vector<Bounds>& boxes = scene.worldBounds();
+    const vector<Scene::Renderable>& renderables = scene.renderables();
+    atomic<unsigned int> tested(0), culled(0);
+    auto job = [&](size_t begin, size_t end) {
+        unsigned int rangeTested = 0, rangeCulled = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (!visibility[i] || renderables[i].count == 0 || !boxes[i].valid())
+                continue;
+            rangeTested++;
+            if (occluded(boxes[i])) {
+                visibility[i] = 0;
+                rangeCulled++;
+            }
+        }
+        tested += rangeTested;
+        culled += rangeCulled;
+    };
+    if (pool)
+        pool->parallelFor(visibility.size(), kTestGrain, job);
+    else
+        job(0, visibility.size());
+
+    stats.tested = tested;
+    stats.culled = culled;
+    stats.testMs = millisecondsSince(start);
+}
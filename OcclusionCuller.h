@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+class Scene;
+class WorkerPool;
+
+// CPU occlusion culling against a few big occluders
+// the occluder triangles are rasterized into a small depth buffer, four
+// pixels per SSE step and one band of rows per worker, then reduced into
+// a pyramid where each texel is the farthest depth of the 2x2 below it.
+// a box is occluded when its nearest point is behind the farthest depth of
+// the pyramid texels its screen rectangle covers, read at the level where
+// that rectangle is at most 2x2 texels
+class OcclusionCuller
+{
+public:
+    struct Stats {
+        unsigned int occluders;
+        unsigned int triangles;
+        // candidates with a renderable and bounds
+        unsigned int tested;
+        unsigned int culled;
+        // rasterization + pyramid, and the box tests
+        float rasterizeMs;
+        float testMs;
+    };
+
+    // depth buffer size; the pyramid halves it down to one texel
+    static const int kWidth = 256;
+    static const int kHeight = 128;
+
+    OcclusionCuller();
+
+    // clears the depth buffer and the occluders of the last frame
+    void begin(const glm::mat4& viewProjection);
+    // object space positions, three per triangle (Mesh::triangles())
+    void addOccluder(const std::vector<glm::vec3>& triangles, const glm::mat4& world);
+    // draws the occluders added since begin() and builds the pyramid
+    void rasterize(WorkerPool* pool = nullptr);
+
+    // true if the world space box is hidden behind the occluders
+    bool occluded(const Bounds& box) const;
+    // visible()[i] = candidates[i] (a FrustumCuller's visible()) unless
+    // dense object i of the scene is occluded
+    void cull(const Scene& scene, const std::vector<uint8_t>& candidates, WorkerPool* pool = nullptr);
+    const std::vector<uint8_t>& visible() const { return visibility; }
+
+    // level 0 is the depth buffer, [0, 1] with 1 the far plane
+    int levelCount() const { return (int)levels.size(); }
+    const std::vector<float>& level(int index) const { return levels[index]; }
+    // counters of the last rasterize() / cull()
+    const Stats& getStats() const { return stats; }
+
+private:
+    // screen space triangle, counter clockwise; inside where all three edge
+    // functions edge[i].x * x + edge[i].y * y + edge[i].z are >= 0, depth
+    // depth.x * x + depth.y * y + depth.z
+    struct Triangle {
+        glm::vec3 edge[3];
+        glm::vec3 depth;
+        int minX, maxX, minY, maxY;
+    };
+
+    // clip space triangle, cut at the near plane when it crosses it
+    void addClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    void addScreenTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+    // every triangle, clipped to rows [firstRow, endRow)
+    void rasterizeRows(int firstRow, int endRow);
+    void buildPyramid();
+
+    glm::mat4 viewProjection;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<float>> levels;
+    std::vector<uint8_t> visibility;
+    Stats stats;
+};
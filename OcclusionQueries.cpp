@@ -0,0 +1,142 @@
+#include "OcclusionQueries.h"
+#include "Scene.h"
+#include "GLState.h"
+#include "UniformTable.h"
+#include "ShaderInterface.h"
+
+using namespace std;
+using namespace ShaderInterface;
+
+namespace {
+    // a box the near plane cuts (or the camera is in) loses the faces that
+    // would pass, so its query can't be trusted
+    bool reachesNearPlane(const glm::mat4& viewProjection, const Bounds& box)
+    {
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(point, 1.f);
+            if (clip.z < -clip.w)
+                return true;
+        }
+        return false;
+    }
+}
+
+OcclusionQueries::OcclusionQueries()
+    : frame(0), stats{ 0, 0, 0, 0 }
+{
+}
+
+OcclusionQueries::Object& OcclusionQueries::object(const Scene& scene, size_t dense)
+{
+    Entity entity = scene.entityAt(dense);
+    if (entity.index >= objects.size())
+        objects.resize(entity.index + 1, { 0, ~0u, false, true, 0 });
+    Object& state = objects[entity.index];
+    if (state.generation != entity.generation) {
+        // a new object starts visible; a result still in flight is the old one's
+        if (!state.query)
+            glGenQueries(1, &state.query);
+        state.generation = entity.generation;
+        state.pending = false;
+        state.visible = true;
+        // staggered over the interval
+        state.nextQuery = frame + entity.index % kVisibleInterval;
+    }
+    return state;
+}
+
+void OcclusionQueries::collect()
+{
+    stats.read = 0;
+    stats.stallsAvoided = 0;
+    for (Object& state : objects) {
+        if (!state.pending)
+            continue;
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            // keep the last visibility and look again next frame
+            stats.stallsAvoided++;
+            continue;
+        }
+        GLuint passed = 0;
+        glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &passed);
+        state.visible = passed != 0;
+        state.pending = false;
+        stats.read++;
+    }
+}
+
+void OcclusionQueries::cull(const Scene& scene, const vector<uint8_t>& candidates)
+{
+    visibility = candidates;
+    stats.skipped = 0;
+    for (size_t i = 0; i < visibility.size(); i++) {
+        if (!visibility[i])
+            continue;
+        if (!object(scene, i).visible) {
+            visibility[i] = 0;
+            stats.skipped++;
+        }
+    }
+}
+
+void OcclusionQueries::issue(const Scene& scene, const vector<uint8_t>& candidates, const glm::mat4& viewProjection,
+    GLState& state, GLuint program, UniformTable& uniforms, GLuint boxVao, GLsizei boxCount)
+{
+    frame++;
+    stats.issued = 0;
+    const vector<Bounds>& boxes = scene.worldBounds();
+    const vector<Scene::Renderable>& renderables = scene.renderables();
+    bool drawing = false;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (!candidates[i] || renderables[i].count == 0 || !boxes[i].valid())
+            continue;
+        Object& target = object(scene, i);
+        if (target.pending || (target.visible && frame < target.nextQuery))
+            continue;
+        if (reachesNearPlane(viewProjection, boxes[i])) {
+            target.visible = true;
+            continue;
+        }
+
+        if (!drawing) {
+            // depth tested, nothing written; both sides so a box the camera
+            // looks into along an edge still counts
+            state.useProgram(program);
+            uniforms.bind(program);
+            state.bindVertexArray(boxVao);
+            state.depthTest(true);
+            state.depthMask(false);
+            state.depthFunc(GL_LEQUAL);
+            state.blend(false);
+            state.cullFace(false);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            drawing = true;
+        }
+        uniforms.set(Box::Uniform::boxCenter, boxes[i].center());
+        uniforms.set(Box::Uniform::boxExtent, boxes[i].extent());
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, target.query);
+        glDrawElements(GL_TRIANGLES, boxCount, GL_UNSIGNED_INT, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        target.pending = true;
+        if (target.visible)
+            target.nextQuery = frame + kVisibleInterval;
+        stats.issued++;
+    }
+    if (drawing) {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        state.depthMask(true);
+        state.depthFunc(GL_LESS);
+    }
+}
+
+void OcclusionQueries::release()
+{
+    for (Object& state : objects) {
+        if (state.query)
+            glDeleteQueries(1, &state.query);
+    }
+    objects.clear();
+}
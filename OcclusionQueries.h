@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Scene;
+class GLState;
+class UniformTable;
+
+// hardware occlusion queries on the world bounds of a scene's objects,
+// with the temporal coherence of CHC++: an object keeps the visibility of
+// its last result, which is read a frame after its box was drawn and never
+// waited for. occluded objects are queried every frame so they come back
+// one frame after they uncover; visible ones only every kVisibleInterval
+// frames, staggered so the queries don't all land on the same frame
+// GL 3.3 has GL_ANY_SAMPLES_PASSED (the CONSERVATIVE variant is GL 4.3);
+// skipped objects aren't drawn at all rather than conditionally rendered,
+// so they cost nothing on the CPU either
+class OcclusionQueries
+{
+public:
+    struct Stats {
+        // box queries drawn by the last issue()
+        unsigned int issued;
+        // results read by the last collect(), and the ones still in flight
+        // that would have stalled the pipeline had they been waited for
+        unsigned int read;
+        unsigned int stallsAvoided;
+        // candidates the last cull() dropped because their box was hidden
+        unsigned int skipped;
+    };
+
+    static const unsigned int kVisibleInterval = 8;
+
+    OcclusionQueries();
+
+    // picks up the results that came in since last frame; call before cull()
+    void collect();
+    // visible()[i] = candidates[i] unless dense object i was occluded when last queried
+    void cull(const Scene& scene, const std::vector<uint8_t>& candidates);
+    const std::vector<uint8_t>& visible() const { return visibility; }
+
+    // draws the boxes of the candidates that are due for a query against
+    // the depth buffer as it is (the frame's opaque geometry drawn), depth
+    // and color writes off; boxVao is a unit cube (corners at -1 / 1) of
+    // boxCount indices for program, which takes Box::Uniform::boxCenter /
+    // boxExtent, with the view projection coming from FrameData
+    void issue(const Scene& scene, const std::vector<uint8_t>& candidates, const glm::mat4& viewProjection,
+        GLState& state, GLuint program, UniformTable& uniforms, GLuint boxVao, GLsizei boxCount);
+
+    // counters of the last collect() / cull() / issue()
+    const Stats& getStats() const { return stats; }
+
+    void release();
+
+private:
+    // per entity slot, so it survives the scene reordering its dense arrays
+    struct Object {
+        GLuint query;
+        // generation of the entity the state belongs to
+        uint32_t generation;
+        // box drawn, result not read yet
+        bool pending;
+        bool visible;
+        // frame a visible object is queried again
+        unsigned int nextQuery;
+    };
+
+    // state of the entity at a dense index, reset when the slot changed hands
+    Object& object(const Scene& scene, size_t dense);
+
+    std::vector<Object> objects;
+    std::vector<uint8_t> visibility;
+    unsigned int frame;
+    Stats stats;
+};
@@ -0,0 +1,235 @@
+#include "ProgramCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <filesystem>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+    struct BinaryHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t length;
+        uint64_t driverHash;
+    };
+
+    const char kMagic[4] = { 'P', 'B', 'I', 'N' };
+    const uint32_t kVersion = 1;
+
+    string glString(GLenum name)
+    {
+        const GLubyte* value = glGetString(name);
+        return value ? (const char*)value : "";
+    }
+}
+
+string ShaderUtil::readFile(const string& path)
+{
+    ifstream src(path, ios::binary);
+    if (!src) {
+        cerr << "can't open " << path << endl;
+        return "";
+    }
+    // one copy straight into the string
+    return string((istreambuf_iterator<char>(src)), istreambuf_iterator<char>());
+}
+
+uint64_t ShaderUtil::hash(const string& text, uint64_t seed)
+{
+    uint64_t h = seed;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+string ShaderUtil::withDefines(const string& source, const string& defines)
+{
+    if (defines.empty())
+        return source;
+    // #version has to stay the first statement
+    size_t versionLine = source.find("#version");
+    if (versionLine == string::npos)
+        return defines + source;
+    size_t lineEnd = source.find('\n', versionLine);
+    if (lineEnd == string::npos)
+        return source + "\n" + defines;
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+GLuint ShaderUtil::compile(GLenum type, const string& source, const string& name)
+{
+    const char* src = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, NULL);
+    glCompileShader(shader);
+
+    if (!checkCompile(shader, type, name)) {
+        // don't leak the shader
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool ShaderUtil::checkCompile(GLuint shader, GLenum type, const string& name)
+{
+    GLint isCompiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if (isCompiled == GL_FALSE) {
+        GLint maxLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+        // the maxLength includes the NULL character
+        vector<GLchar> errorLog(max(maxLength, 1));
+        glGetShaderInfoLog(shader, maxLength, &maxLength, &errorLog[0]);
+        const char* stage;
+        switch (type) {
+        case GL_VERTEX_SHADER: stage = " (vertex)"; break;
+        case GL_FRAGMENT_SHADER: stage = " (fragment)"; break;
+        case GL_COMPUTE_SHADER: stage = " (compute)"; break;
+        default: stage = ""; break;
+        }
+        cerr << name << stage << " failed to compile:" << endl << &errorLog[0] << endl;
+        return false;
+    }
+    return true;
+}
+
+bool ShaderUtil::checkLink(GLuint program, const string& name)
+{
+    GLint isLinked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (isLinked == GL_FALSE) {
+        GLint maxLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+        vector<GLchar> errorLog(max(maxLength, 1));
+        glGetProgramInfoLog(program, maxLength, &maxLength, &errorLog[0]);
+        cerr << name << " failed to link:" << endl << &errorLog[0] << endl;
+        return false;
+    }
+    return true;
+}
+
+ProgramCache::ProgramCache(const string& directory)
+    : directory(directory)
+{
+    stats.hits = 0;
+    stats.misses = 0;
+    stats.rejected = 0;
+
+    driverHash = ShaderUtil::hash(glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION));
+
+    // some drivers expose the entry points without a single binary format
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    supported = formats > 0;
+
+    if (supported) {
+        error_code ec;
+        filesystem::create_directories(directory, ec);
+    }
+}
+
+uint64_t ProgramCache::key(const ProgramSource& source) const
+{
+    uint64_t h = ShaderUtil::hash(source.vertex);
+    h = ShaderUtil::hash("\n--fragment--\n" + source.fragment, h);
+    h = ShaderUtil::hash("\n--defines--\n" + source.defines, h);
+    if (!source.compute.empty())
+        h = ShaderUtil::hash("\n--compute--\n" + source.compute, h);
+    // a different driver never sees binaries from another one
+    h ^= driverHash + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+string ProgramCache::path(uint64_t key) const
+{
+    stringstream name;
+    name << directory << "/" << hex << setw(16) << setfill('0') << key << ".bin";
+    return name.str();
+}
+
+bool ProgramCache::load(uint64_t key, GLuint program)
+{
+    if (!restore(key, program)) {
+        stats.misses++;
+        return false;
+    }
+    stats.hits++;
+    return true;
+}
+
+bool ProgramCache::restore(uint64_t key, GLuint program)
+{
+    if (!supported)
+        return false;
+
+    ifstream file(path(key), ios::binary);
+    if (!file)
+        return false;
+    BinaryHeader header;
+    if (!file.read((char*)&header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.driverHash != driverHash)
+        return false;
+    vector<char> binary(header.length);
+    if (!file.read(binary.data(), (streamsize)binary.size()))
+        return false;
+    file.close();
+
+    glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+    GLint isLinked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+    if (isLinked == GL_FALSE) {
+        // stale binary: drop it so the next launch doesn't try again
+        stats.rejected++;
+        error_code ec;
+        filesystem::remove(path(key), ec);
+        return false;
+    }
+    return true;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program)
+{
+    if (!supported)
+        return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    BinaryHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.format = format;
+    header.length = (uint32_t)length;
+    header.driverHash = driverHash;
+
+    // write next to the final file and swap it in so a crash never leaves half a binary
+    string temp = path(key) + ".tmp";
+    {
+        ofstream file(temp, ios::binary | ios::trunc);
+        if (!file)
+            return;
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            return;
+    }
+    error_code ec;
+    filesystem::rename(temp, path(key), ec);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <glad/glad.h>
+
+// sources of one vertex + fragment program
+struct ProgramSource {
+    // only used in log messages
+    std::string name;
+    std::string vertex;
+    std::string fragment;
+    // files the stages were read from, empty for built-in sources
+    std::string vertexPath;
+    std::string fragmentPath;
+    // a compute program has this stage only, vertex / fragment stay empty
+    std::string compute;
+    std::string computePath;
+    // "#define X\n" lines inserted after the #version line of both stages
+    std::string defines;
+};
+
+// persistent cache of linked program binaries
+// binaries are stored as <directory>/<key>.bin where the key hashes both
+// sources, the defines and the GL vendor/renderer/version strings; a binary
+// the driver refuses (e.g. after a driver update) is deleted and the program
+// is rebuilt from source
+class ProgramCache
+{
+public:
+    struct Stats {
+        unsigned int hits;
+        unsigned int misses;
+        // binaries the driver refused to load
+        unsigned int rejected;
+    };
+
+    explicit ProgramCache(const std::string& directory);
+
+    uint64_t key(const ProgramSource& source) const;
+    // restore a binary into a fresh program, counted as a hit; false (a miss)
+    // if there is none or the driver refused it
+    bool load(uint64_t key, GLuint program);
+    // write the binary of a linked program
+    void store(uint64_t key, GLuint program);
+
+    bool enabled() const { return supported; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    std::string path(uint64_t key) const;
+    bool restore(uint64_t key, GLuint program);
+
+    std::string directory;
+    // hash of the vendor/renderer/version strings
+    uint64_t driverHash;
+    bool supported;
+    Stats stats;
+};
+
+namespace ShaderUtil {
+    // whole file as a string, empty if it can't be opened
+    std::string readFile(const std::string& path);
+    // 64-bit FNV-1a
+    uint64_t hash(const std::string& text, uint64_t seed = 14695981039346656037ull);
+    // put the defines right after the #version line
+    std::string withDefines(const std::string& source, const std::string& defines);
+    // compile one stage, printing the info log on failure; 0 on failure
+    GLuint compile(GLenum type, const std::string& source, const std::string& name);
+    // check the compile status, printing the info log on failure
+    bool checkCompile(GLuint shader, GLenum type, const std::string& name);
+    // check the link status, printing the info log on failure
+    bool checkLink(GLuint program, const std::string& name);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// passes of a frame in the order they are drawn; the pass is the top field
+// of the render queue's sort key
+enum RenderPass {
+    // depth tested and written, front to back, no blending
+    PASS_OPAQUE,
+    // alpha tested; after opaque so discarding shaders run on fewer fragments
+    PASS_CUTOUT,
+    // drawn at the far plane with GL_LEQUAL, so only uncovered pixels get shaded
+    PASS_SKYBOX,
+    // blended back to front over everything, depth tested but not written
+    PASS_TRANSPARENT,
+};
+const int kRenderPassCount = 4;
+const char* const kRenderPassNames[kRenderPassCount] = { "opaque", "cutout", "skybox", "transparent" };
@@ -0,0 +1,339 @@
+#include "RenderQueue.h"
+#include "GLState.h"
+#include "UniformTable.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    const int kPassBits = 4;
+    const int kProgramBits = 12;
+    const int kMaterialBits = 16;
+    const int kVaoBits = 8;
+    const int kDepthBits = 24;
+
+    const int kDepthShift = 0;
+    const int kVaoShift = kDepthShift + kDepthBits;
+    const int kMaterialShift = kVaoShift + kVaoBits;
+    const int kProgramShift = kMaterialShift + kMaterialBits;
+    const int kPassShift = kProgramShift + kProgramBits;
+    static_assert(kPassShift + kPassBits == 64, "sort key fields have to fill 64 bits");
+
+    uint64_t field(uint64_t key, int shift, int bits)
+    {
+        return (key >> shift) & ((1ull << bits) - 1);
+    }
+}
+
+RenderQueue::RenderQueue()
+    : stats(), timing(false), multiDraw(false), drawObjectBuffer(0), commandBuffer(0), drawIndexBuffer(0), drawIndexCount(0)
+{
+    PassState opaque = { true, true, GL_LESS, false, false };
+    for (PassState& pass : passes)
+        pass = opaque;
+    // pos.xyww puts the skybox exactly on the far plane the depth buffer is cleared to
+    passes[PASS_SKYBOX] = { true, false, GL_LEQUAL, false, false };
+    passes[PASS_TRANSPARENT] = { true, false, GL_LESS, true, true };
+}
+
+void RenderQueue::release()
+{
+    for (GpuTimer& timer : timers)
+        timer.release();
+    glDeleteBuffers(1, &drawObjectBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &drawIndexBuffer);
+    drawObjectBuffer = commandBuffer = drawIndexBuffer = 0;
+    drawIndexCount = 0;
+}
+
+bool RenderQueue::multiDrawSupported()
+{
+    return GLAD_GL_VERSION_4_3 != 0;
+}
+
+void RenderQueue::setPass(int pass, const PassState& state)
+{
+    if (pass >= 0 && pass < kMaxPasses)
+        passes[pass] = state;
+}
+
+unsigned int RenderQueue::idOf(unordered_map<GLuint, unsigned int>& ids, GLuint name, unsigned int limit)
+{
+    auto it = ids.find(name);
+    if (it != ids.end())
+        return it->second;
+    // hot reloads keep handing out new program names; start over rather than
+    // run out, ids only have to be consistent within a frame
+    if (ids.size() >= limit)
+        ids.clear();
+    unsigned int id = (unsigned int)ids.size();
+    ids[name] = id;
+    return id;
+}
+
+uint64_t RenderQueue::makeKey(int pass, GLuint program, unsigned int material, GLuint vao, float depth)
+{
+    depth = min(max(depth, 0.f), 1.f);
+    if (pass >= 0 && pass < kMaxPasses && passes[pass].backToFront)
+        depth = 1.f - depth;
+    uint64_t depthBits = (uint64_t)(depth * (float)((1u << kDepthBits) - 1));
+    return (uint64_t)(pass & ((1 << kPassBits) - 1)) << kPassShift
+        | (uint64_t)idOf(programIds, program, 1u << kProgramBits) << kProgramShift
+        | (uint64_t)(material & ((1u << kMaterialBits) - 1)) << kMaterialShift
+        | (uint64_t)idOf(vaoIds, vao, 1u << kVaoBits) << kVaoShift
+        | depthBits << kDepthShift;
+}
+
+DrawPacket& RenderQueue::add()
+{
+    packets.emplace_back();
+    DrawPacket& packet = packets.back();
+    packet.key = 0;
+    packet.uniforms = nullptr;
+    packet.mode = GL_TRIANGLES;
+    packet.indexed = false;
+    packet.first = 0;
+    packet.baseVertex = 0;
+    packet.instances = 0;
+    packet.textureCount = 0;
+    packet.hasObject = false;
+    packet.batchProgram = 0;
+    packet.batchUniforms = nullptr;
+    return packet;
+}
+
+void RenderQueue::sort()
+{
+    size_t count = packets.size();
+    order.resize(count);
+    scratch.resize(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = make_pair(packets[i].key, (uint32_t)i);
+
+    // bits that differ somewhere; digits without any are already sorted
+    uint64_t differing = 0;
+    for (size_t i = 1; i < count; i++)
+        differing |= order[i].first ^ order[0].first;
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((differing >> shift) & 0xff) == 0)
+            continue;
+        size_t offsets[256] = {};
+        for (const pair<uint64_t, uint32_t>& entry : order)
+            offsets[(entry.first >> shift) & 0xff]++;
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t bucket = offset;
+            offset = total;
+            total += bucket;
+        }
+        for (const pair<uint64_t, uint32_t>& entry : order)
+            scratch[offsets[(entry.first >> shift) & 0xff]++] = entry;
+        order.swap(scratch);
+    }
+}
+
+bool RenderQueue::batchable(const DrawPacket& a, const DrawPacket& b)
+{
+    if (!a.batchProgram || a.batchProgram != b.batchProgram || !a.hasObject || !b.hasObject)
+        return false;
+    if (a.instances > 0 || b.instances > 0 || a.vao != b.vao || a.mode != b.mode || a.indexed != b.indexed)
+        return false;
+    if (field(a.key, kPassShift, kPassBits) != field(b.key, kPassShift, kPassBits) || a.textureCount != b.textureCount)
+        return false;
+    for (int t = 0; t < a.textureCount; t++) {
+        if (a.textures[t].unit != b.textures[t].unit || a.textures[t].target != b.textures[t].target
+            || a.textures[t].texture != b.textures[t].texture)
+            return false;
+    }
+    return true;
+}
+
+void RenderQueue::buildBatches()
+{
+    batches.clear();
+    drawObjects.clear();
+    commands.clear();
+    if (!multiDraw)
+        return;
+
+    for (size_t i = 0; i < order.size();) {
+        const DrawPacket& first = packets[order[i].second];
+        size_t end = i + 1;
+        while (end < order.size() && batchable(first, packets[order[end].second]))
+            end++;
+        if (end - i >= kMinBatch) {
+            batches.push_back({ i, end - i, commands.size() * sizeof(GLuint) });
+            for (size_t j = i; j < end; j++) {
+                const DrawPacket& packet = packets[order[j].second];
+                GLuint base = (GLuint)drawObjects.size();
+                drawObjects.emplace_back();
+                ShaderInterface::DrawObject& object = drawObjects.back();
+                object.transform = packet.object.transform;
+                object.normalMatrix = packet.object.normalMatrix;
+                object.specStr = packet.object.specStr;
+                object.specPhong = packet.object.specPhong;
+                // DrawElementsIndirectCommand / DrawArraysIndirectCommand, one instance
+                if (packet.indexed)
+                    commands.insert(commands.end(), { (GLuint)packet.count, 1, (GLuint)packet.first, (GLuint)packet.baseVertex, base });
+                else
+                    commands.insert(commands.end(), { (GLuint)packet.count, 1, (GLuint)packet.first, base });
+            }
+        }
+        i = end;
+    }
+    if (batches.empty())
+        return;
+
+    if (!drawObjectBuffer) {
+        glGenBuffers(1, &drawObjectBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &drawIndexBuffer);
+    }
+    if (drawObjects.size() > drawIndexCount) {
+        drawIndexCount = max(drawObjects.size(), drawIndexCount * 2);
+        vector<GLuint> indices(drawIndexCount);
+        for (size_t i = 0; i < drawIndexCount; i++)
+            indices[i] = (GLuint)i;
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // orphaned every frame like the instance buffers
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawObjectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, drawObjects.size() * sizeof(ShaderInterface::DrawObject), drawObjects.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kDrawObjectsBinding, drawObjectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(GLuint), commands.data(), GL_STREAM_DRAW);
+}
+
+void RenderQueue::bindPacket(GLState& state, const DrawPacket& packet, GLuint program, UniformTable* uniforms)
+{
+    state.useProgram(program);
+    if (uniforms)
+        uniforms->bind(program);
+    state.bindVertexArray(packet.vao);
+    for (int t = 0; t < packet.textureCount; t++) {
+        const DrawPacket::Texture& texture = packet.textures[t];
+        state.bindTexture(texture.unit, texture.target, texture.texture);
+        if (uniforms)
+            uniforms->set(texture.sampler, texture.unit);
+    }
+}
+
+void RenderQueue::submit(GLState& state, UniformBlock<ShaderInterface::ObjectData>& objectBlock)
+{
+    stats = Stats();
+    if (timing) {
+        for (GpuTimer& timer : timers)
+            timer.collect();
+    }
+    // sort() wasn't called: insertion order
+    if (order.size() != packets.size()) {
+        order.resize(packets.size());
+        for (size_t i = 0; i < packets.size(); i++)
+            order[i] = make_pair(packets[i].key, (uint32_t)i);
+    }
+    buildBatches();
+
+    int pass = -1;
+    uint64_t previous = 0;
+    size_t nextBatch = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        const DrawPacket& packet = packets[order[i].second];
+        uint64_t key = packet.key;
+
+        int packetPass = (int)field(key, kPassShift, kPassBits);
+        if (packetPass != pass) {
+            if (timing && pass >= 0)
+                timers[pass].end();
+            pass = packetPass;
+            if (timing)
+                timers[pass].begin();
+            const PassState& passState = passes[pass];
+            state.depthTest(passState.depthTest);
+            state.depthMask(passState.depthWrite);
+            state.depthFunc(passState.depthFunc);
+            state.blend(passState.blend);
+        }
+        if (i == 0 || field(key, kProgramShift, kProgramBits) != field(previous, kProgramShift, kProgramBits))
+            stats.programChanges++;
+        if (i == 0 || field(key, kMaterialShift, kMaterialBits) != field(previous, kMaterialShift, kMaterialBits))
+            stats.materialChanges++;
+        if (i == 0 || field(key, kVaoShift, kVaoBits) != field(previous, kVaoShift, kVaoBits))
+            stats.vaoChanges++;
+        previous = key;
+
+        if (nextBatch < batches.size() && batches[nextBatch].first == i) {
+            const Batch& batch = batches[nextBatch++];
+            bindPacket(state, packet, packet.batchProgram, packet.batchUniforms);
+            // the VAO's draw index attribute; set every time since VAOs come and go
+            glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+            glEnableVertexAttribArray(kDrawIndexAttrib);
+            glVertexAttribIPointer(kDrawIndexAttrib, 1, GL_UNSIGNED_INT, 0, 0);
+            glVertexAttribDivisor(kDrawIndexAttrib, 1);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            const void* offset = (const void*)batch.commandOffset;
+            if (packet.indexed)
+                glMultiDrawElementsIndirect(packet.mode, GL_UNSIGNED_INT, offset, (GLsizei)batch.count, 0);
+            else
+                glMultiDrawArraysIndirect(packet.mode, offset, (GLsizei)batch.count, 0);
+            // off again: the array only holds drawIndexCount entries, an instanced
+            // draw of the same VAO with more instances would read past its end
+            glDisableVertexAttribArray(kDrawIndexAttrib);
+            stats.draws += (unsigned int)batch.count;
+            stats.batchedDraws += (unsigned int)batch.count;
+            stats.multiDraws++;
+            stats.passDraws[pass] += (unsigned int)batch.count;
+            // the rest of the run shares program, material textures and VAO
+            i += batch.count - 1;
+            previous = packets[order[i].second].key;
+            continue;
+        }
+
+        bindPacket(state, packet, packet.program, packet.uniforms);
+        if (packet.hasObject) {
+            objectBlock.data = packet.object;
+            objectBlock.upload();
+        }
+
+        const void* indices = (const void*)(packet.first * sizeof(GLuint));
+        if (packet.instances > 0) {
+            if (packet.indexed)
+                glDrawElementsInstancedBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, indices, packet.instances, packet.baseVertex);
+            else
+                glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instances);
+        }
+        else if (packet.indexed)
+            glDrawElementsBaseVertex(packet.mode, packet.count, GL_UNSIGNED_INT, indices, packet.baseVertex);
+        else
+            glDrawArrays(packet.mode, packet.first, packet.count);
+        stats.draws++;
+        stats.passDraws[pass]++;
+    }
+    if (timing && pass >= 0)
+        timers[pass].end();
+    if (!batches.empty())
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+double RenderQueue::passGpuMs(int pass) const
+{
+    return pass >= 0 && pass < kMaxPasses ? timers[pass].averageMs() : 0.0;
+}
+
+void RenderQueue::resetPassTimes()
+{
+    for (GpuTimer& timer : timers)
+        timer.reset();
+}
+
+void RenderQueue::clear()
+{
+    packets.clear();
+    order.clear();
+}
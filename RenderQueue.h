@@ -0,0 +1,173 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <glad/glad.h>
+
+#include "ShaderInterface.h"
+#include "UniformBlock.h"
+#include "RenderPass.h"
+#include "GpuTimer.h"
+
+class GLState;
+class UniformTable;
+
+// one draw call with everything it needs bound
+struct DrawPacket {
+    struct Texture {
+        // sampler uniform the unit is assigned to
+        const char* sampler;
+        int unit;
+        GLenum target;
+        GLuint texture;
+    };
+    static const int kMaxTextures = 2;
+
+    // RenderQueue::makeKey
+    uint64_t key;
+    GLuint program;
+    // reflected uniforms of program, for the sampler units
+    UniformTable* uniforms;
+    GLuint vao;
+    GLenum mode;
+    GLsizei count;
+    // GL_UNSIGNED_INT indices from the VAO's element buffer
+    bool indexed;
+    // first index (or vertex when not indexed) and base vertex, for
+    // geometry sharing its buffers with other meshes (GeometryPool)
+    GLint first;
+    GLint baseVertex;
+    // > 0: drawn instanced, the VAO carries the per-instance attributes
+    GLsizei instances;
+    Texture textures[kMaxTextures];
+    int textureCount;
+    // uploaded to the ObjectData block before the draw
+    bool hasObject;
+    ShaderInterface::ObjectData object;
+    // variant of program reading object from the DrawObjects storage buffer
+    // instead (sample's MULTI_DRAW), 0 if there is none ready; needed for
+    // the packet to go into a multi draw
+    GLuint batchProgram;
+    UniformTable* batchUniforms;
+};
+
+// draws of one frame, sorted by a 64-bit key before they are submitted
+// key, most significant first:
+//   pass 4 | program 12 | material 16 | vao 8 | depth 24
+// so within a pass every program is bound once, every material once per
+// program and so on; the depth bits only order draws that share all of that
+// packets are sorted through an index, an 8-bit LSD radix sort over
+// (key, index) pairs that skips the digits every key has in common
+// with multi draw on (GL 4.3), a run of sorted packets sharing batch
+// program, VAO, textures and draw mode goes out as one
+// glMultiDraw*Indirect: their object data is written into one storage
+// buffer up front and each command's base instance selects its entry;
+// meshes sharing a GeometryPool share its VAO, so a run spans meshes
+class RenderQueue
+{
+public:
+    static const int kMaxPasses = 16;
+    // storage buffer binding of DrawObjects, and the per instance draw index
+    // attribute the batches point at a buffer counting up from 0
+    static const GLuint kDrawObjectsBinding = 3;
+    static const GLuint kDrawIndexAttrib = ShaderInterface::Sample::Attrib::drawIndex;
+    // shorter runs are drawn one packet at a time
+    static const size_t kMinBatch = 2;
+
+    // depth test / write / compare and blending of a pass
+    struct PassState {
+        bool depthTest;
+        bool depthWrite;
+        GLenum depthFunc;
+        bool blend;
+        // far to near instead of near to far within the pass
+        bool backToFront;
+    };
+
+    struct Stats {
+        // packets drawn, the ones drawn through a multi draw and those calls
+        unsigned int draws;
+        unsigned int batchedDraws;
+        unsigned int multiDraws;
+        unsigned int passDraws[kMaxPasses];
+        // state switches between consecutive packets after sorting
+        unsigned int programChanges;
+        unsigned int materialChanges;
+        unsigned int vaoChanges;
+    };
+
+    // the RenderPass passes are set up with their state, the rest like PASS_OPAQUE
+    RenderQueue();
+    // delete the timer queries; call while the context is still alive
+    void release();
+
+    // state applied when submission reaches the pass
+    void setPass(int pass, const PassState& state);
+
+    static bool multiDrawSupported();
+    // off until enabled, and stays off without GL 4.3
+    void setMultiDraw(bool enabled) { multiDraw = enabled && multiDrawSupported(); }
+    bool multiDrawEnabled() const { return multiDraw; }
+
+    // material is any id the caller uses for a texture set, < 65536;
+    // depth in [0, 1], 0 = at the camera; flipped for back to front passes
+    uint64_t makeKey(int pass, GLuint program, unsigned int material, GLuint vao, float depth);
+
+    // packet to fill in; its key has to be set before sort()
+    DrawPacket& add();
+    void sort();
+    // draw in sorted order, state through the cache and object data through the block
+    void submit(GLState& state, UniformBlock<ShaderInterface::ObjectData>& objectBlock);
+    // drop the packets, call after submit() every frame
+    void clear();
+
+    size_t size() const { return packets.size(); }
+    // counters of the last submit()
+    const Stats& getStats() const { return stats; }
+
+    // GPU time of every pass; off by default, and has to stay off while
+    // another GL_TIME_ELAPSED query is open around submit()
+    void setPassTiming(bool enabled) { timing = enabled; }
+    // average ms of the pass since the last resetPassTimes()
+    double passGpuMs(int pass) const;
+    void resetPassTimes();
+
+private:
+    // packets order[first, first + count) drawn by one multi draw
+    struct Batch {
+        size_t first;
+        size_t count;
+        // byte offset of the first command in commandBuffer
+        size_t commandOffset;
+    };
+
+    // small dense id for a GL name, handed out on first use
+    unsigned int idOf(std::unordered_map<GLuint, unsigned int>& ids, GLuint name, unsigned int limit);
+    // whether b can follow a in the same multi draw
+    static bool batchable(const DrawPacket& a, const DrawPacket& b);
+    // finds the runs, uploads their objects and commands
+    void buildBatches();
+    void bindPacket(GLState& state, const DrawPacket& packet, GLuint program, UniformTable* uniforms);
+
+    std::vector<DrawPacket> packets;
+    // (key, packet index), sorted in place; scratch is the radix sort's other buffer
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    std::vector<std::pair<uint64_t, uint32_t>> scratch;
+    std::unordered_map<GLuint, unsigned int> programIds;
+    std::unordered_map<GLuint, unsigned int> vaoIds;
+    PassState passes[kMaxPasses];
+    Stats stats;
+    bool timing;
+    GpuTimer timers[kMaxPasses];
+
+    bool multiDraw;
+    std::vector<Batch> batches;
+    std::vector<ShaderInterface::DrawObject> drawObjects;
+    std::vector<GLuint> commands;
+    GLuint drawObjectBuffer;
+    GLuint commandBuffer;
+    // 0, 1, 2, ... for kDrawIndexAttrib, as long as the longest frame's batches
+    GLuint drawIndexBuffer;
+    size_t drawIndexCount;
+};
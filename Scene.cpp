@@ -0,0 +1,235 @@
+#include "Scene.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    // fill the hole at index with the last element
+    template <typename T>
+    void removeSwap(vector<T>& values, size_t index)
+    {
+        values[index] = values.back();
+        values.pop_back();
+    }
+
+    // objects per updateTransforms() chunk on the pool
+    const size_t kUpdateGrain = 1024;
+}
+
+Entity Scene::create()
+{
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else {
+        slot = (uint32_t)slotGeneration.size();
+        slotGeneration.push_back(0);
+        slotDense.push_back(0);
+    }
+    slotDense[slot] = (uint32_t)size();
+
+    denseSlot.push_back(slot);
+    for (vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ })
+        component->push_back(0.f);
+    for (vector<float>* component : { &rotationW, &scaleX, &scaleY, &scaleZ })
+        component->push_back(1.f);
+    spins.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+    spinning.push_back(0);
+    dirty.push_back(1);
+    worlds.push_back(glm::mat4(1.f));
+    normals.push_back(glm::mat3(1.f));
+    localBoxes.push_back(Bounds::empty());
+    worldBoxes.push_back(Bounds::empty());
+    renderItems.push_back({ 0, 0, 0, false, 0, 0 });
+    return { slot, slotGeneration[slot] };
+}
+
+void Scene::destroy(Entity entity)
+{
+    if (!alive(entity))
+        return;
+    size_t dense = indexOf(entity);
+    // the last object takes the hole
+    slotDense[denseSlot.back()] = (uint32_t)dense;
+    removeSwap(denseSlot, dense);
+    for (vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ,
+        &rotationW, &scaleX, &scaleY, &scaleZ })
+        removeSwap(*component, dense);
+    removeSwap(spins, dense);
+    removeSwap(spinning, dense);
+    removeSwap(dirty, dense);
+    removeSwap(worlds, dense);
+    removeSwap(normals, dense);
+    removeSwap(localBoxes, dense);
+    removeSwap(worldBoxes, dense);
+    removeSwap(renderItems, dense);
+
+    // handles still pointing at the slot no longer match
+    slotGeneration[entity.index]++;
+    freeSlots.push_back(entity.index);
+}
+
+bool Scene::alive(Entity entity) const
+{
+    return entity.index < slotGeneration.size() && slotGeneration[entity.index] == entity.generation;
+}
+
+void Scene::clear()
+{
+    for (uint32_t slot : denseSlot) {
+        slotGeneration[slot]++;
+        freeSlots.push_back(slot);
+    }
+    denseSlot.clear();
+    for (vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ,
+        &rotationW, &scaleX, &scaleY, &scaleZ })
+        component->clear();
+    spins.clear();
+    spinning.clear();
+    dirty.clear();
+    worlds.clear();
+    normals.clear();
+    localBoxes.clear();
+    worldBoxes.clear();
+    renderItems.clear();
+}
+
+glm::quat Scene::loadRotation(size_t dense) const
+{
+    return glm::quat(rotationW[dense], rotationX[dense], rotationY[dense], rotationZ[dense]);
+}
+
+void Scene::storeRotation(size_t dense, const glm::quat& rotation)
+{
+    rotationX[dense] = rotation.x;
+    rotationY[dense] = rotation.y;
+    rotationZ[dense] = rotation.z;
+    rotationW[dense] = rotation.w;
+}
+
+glm::vec3 Scene::position(Entity entity) const
+{
+    size_t dense = indexOf(entity);
+    return glm::vec3(positionX[dense], positionY[dense], positionZ[dense]);
+}
+
+glm::quat Scene::rotation(Entity entity) const
+{
+    return loadRotation(indexOf(entity));
+}
+
+glm::vec3 Scene::scale(Entity entity) const
+{
+    size_t dense = indexOf(entity);
+    return glm::vec3(scaleX[dense], scaleY[dense], scaleZ[dense]);
+}
+
+void Scene::setPosition(Entity entity, const glm::vec3& position)
+{
+    size_t dense = indexOf(entity);
+    positionX[dense] = position.x;
+    positionY[dense] = position.y;
+    positionZ[dense] = position.z;
+    markDirty(dense);
+}
+
+void Scene::setRotation(Entity entity, const glm::quat& rotation)
+{
+    size_t dense = indexOf(entity);
+    storeRotation(dense, rotation);
+    markDirty(dense);
+}
+
+void Scene::setScale(Entity entity, const glm::vec3& scale)
+{
+    size_t dense = indexOf(entity);
+    scaleX[dense] = scale.x;
+    scaleY[dense] = scale.y;
+    scaleZ[dense] = scale.z;
+    markDirty(dense);
+}
+
+void Scene::rotate(Entity entity, float degrees, const glm::vec3& axis)
+{
+    size_t dense = indexOf(entity);
+    storeRotation(dense, glm::normalize(glm::angleAxis(glm::radians(degrees), glm::normalize(axis)) * loadRotation(dense)));
+    markDirty(dense);
+}
+
+void Scene::setSpin(Entity entity, float degreesPerFrame, const glm::vec3& axis)
+{
+    size_t dense = indexOf(entity);
+    spins[dense] = glm::angleAxis(glm::radians(degreesPerFrame), glm::normalize(axis));
+    spinning[dense] = degreesPerFrame != 0.f;
+}
+
+void Scene::setLocalBounds(Entity entity, const Bounds& bounds)
+{
+    size_t dense = indexOf(entity);
+    localBoxes[dense] = bounds;
+    markDirty(dense);
+}
+
+void Scene::setRenderable(Entity entity, const Renderable& renderable)
+{
+    renderItems[indexOf(entity)] = renderable;
+}
+
+void Scene::spin()
+{
+    size_t count = size();
+    for (size_t i = 0; i < count; i++) {
+        if (!spinning[i])
+            continue;
+        storeRotation(i, glm::normalize(spins[i] * loadRotation(i)));
+        dirty[i] = 1;
+    }
+}
+
+TransformKernel::Arrays Scene::transformArrays() const
+{
+    return { positionX.data(), positionY.data(), positionZ.data(),
+        rotationX.data(), rotationY.data(), rotationZ.data(), rotationW.data(),
+        scaleX.data(), scaleY.data(), scaleZ.data() };
+}
+
+void Scene::updateTransforms(WorkerPool* pool)
+{
+    if (pool)
+        pool->parallelFor(size(), kUpdateGrain, [this](size_t begin, size_t end) { updateRange(begin, end); });
+    else
+        updateRange(0, size());
+}
+
+void Scene::updateRange(size_t begin, size_t end)
+{
+    TransformKernel::Arrays arrays = transformArrays();
+    // consecutive groups of four with a changed object go to the kernel in
+    // one call; recomputing the unchanged ones in a group gives the same result
+    size_t runBegin = end;
+    for (size_t group = begin; group < end; group += 4) {
+        size_t groupEnd = min(group + 4, end);
+        bool changed = false;
+        for (size_t i = group; i < groupEnd; i++)
+            changed |= dirty[i] != 0;
+        if (changed && runBegin == end)
+            runBegin = group;
+        else if (!changed && runBegin != end) {
+            TransformKernel::compose(arrays, runBegin, group, worlds.data(), normals.data());
+            runBegin = end;
+        }
+    }
+    if (runBegin != end)
+        TransformKernel::compose(arrays, runBegin, end, worlds.data(), normals.data());
+
+    for (size_t i = begin; i < end; i++) {
+        if (!dirty[i])
+            continue;
+        dirty[i] = 0;
+        worldBoxes[i] = localBoxes[i].valid() ? localBoxes[i].transformed(worlds[i]) : Bounds::empty();
+    }
+}
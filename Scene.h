@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Bounds.h"
+#include "TransformKernel.h"
+
+class WorkerPool;
+
+// handle to an object in a Scene; goes stale when the object is destroyed,
+// even if its slot is reused by a later create()
+struct Entity {
+    uint32_t index;
+    uint32_t generation;
+};
+
+// objects of the frame as parallel arrays (one per component), packed
+// so that entity i of every array belongs to the same object; systems walk
+// them front to back. position, rotation and scale are split further into
+// one array per float for the SIMD transform kernel. destroy() moves the
+// last object into the hole, so the dense order changes, entities stay valid
+class Scene
+{
+public:
+    // what the render system queues for an object
+    struct Renderable {
+        // index into the caller's materials
+        unsigned int material;
+        GLuint vao;
+        GLsizei count;
+        bool indexed;
+        // where the geometry starts in vao's buffers (first index, or first
+        // vertex without indices) and the base vertex of indexed draws; both
+        // 0 unless it's a GeometryPool range
+        GLint first = 0;
+        GLint baseVertex = 0;
+    };
+
+    // at the origin, unrotated, scale 1, no renderable (count 0), empty bounds
+    Entity create();
+    void destroy(Entity entity);
+    bool alive(Entity entity) const;
+    void clear();
+
+    // live objects = length of every dense array
+    size_t size() const { return denseSlot.size(); }
+    // dense index of a live entity
+    size_t indexOf(Entity entity) const { return slotDense[entity.index]; }
+    // live entity at a dense index
+    Entity entityAt(size_t dense) const { return { denseSlot[dense], slotGeneration[denseSlot[dense]] }; }
+
+    // the setters mark the transform for the next updateTransforms()
+    void setPosition(Entity entity, const glm::vec3& position);
+    void setRotation(Entity entity, const glm::quat& rotation);
+    void setScale(Entity entity, const glm::vec3& scale);
+    // rotation about a world axis, added on top of the current one
+    void rotate(Entity entity, float degrees, const glm::vec3& axis);
+    // rotation spin() adds every frame; 0 degrees stops it
+    void setSpin(Entity entity, float degreesPerFrame, const glm::vec3& axis);
+    // box of the mesh in object space, worldBounds() follows the transform
+    void setLocalBounds(Entity entity, const Bounds& bounds);
+    void setRenderable(Entity entity, const Renderable& renderable);
+
+    glm::vec3 position(Entity entity) const;
+    glm::quat rotation(Entity entity) const;
+    glm::vec3 scale(Entity entity) const;
+
+    // systems, once per frame in this order
+    // advance every spinning object
+    void spin();
+    // world / normal matrix and world bounds of the objects that changed;
+    // world = translate * scale * rotate, through TransformKernel and split
+    // over the pool's threads when one is given
+    void updateTransforms(WorkerPool* pool = nullptr);
+
+    // dense arrays, valid after updateTransforms()
+    const std::vector<glm::mat4>& worldMatrices() const { return worlds; }
+    const std::vector<glm::mat3>& normalMatrices() const { return normals; }
+    const std::vector<Bounds>& worldBounds() const { return worldBoxes; }
+    const std::vector<Renderable>& renderables() const { return renderItems; }
+    // the split transform arrays, as the kernel reads them
+    TransformKernel::Arrays transformArrays() const;
+
+private:
+    void markDirty(size_t dense) { dirty[dense] = 1; }
+    glm::quat loadRotation(size_t dense) const;
+    void storeRotation(size_t dense, const glm::quat& rotation);
+    void updateRange(size_t begin, size_t end);
+
+    // slot -> generation / dense index; free slots are reused first
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> slotDense;
+    std::vector<uint32_t> freeSlots;
+
+    // dense, one entry per live object
+    std::vector<uint32_t> denseSlot;
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    // spin as a per-frame rotation, identity for most objects
+    std::vector<glm::quat> spins;
+    std::vector<uint8_t> spinning;
+    std::vector<uint8_t> dirty;
+    std::vector<glm::mat4> worlds;
+    std::vector<glm::mat3> normals;
+    std::vector<Bounds> localBoxes;
+    std::vector<Bounds> worldBoxes;
+    std::vector<Renderable> renderItems;
+};
@@ -0,0 +1,322 @@
+#include "ShaderBuildQueue.h"
+#include "ShaderInterface.h"
+#include "UniformTable.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    // same attribute and matrix interface as sample.vert so any mesh can use it;
+    // the blocks are declared in full, every program bound to a binding point
+    // has to agree on its layout
+    const char* kFallbackVert =
+        "#version 330 core\n"
+        "layout(location = 0) in vec3 aPos;\n"
+        "struct Light {\n"
+        "    vec4 position;\n"
+        "    vec4 color;\n"
+        "};\n"
+        "layout(std140) uniform FrameData {\n"
+        "    mat4 view;\n"
+        "    mat4 projection;\n"
+        "    mat4 viewProj;\n"
+        "    vec4 cameraPos;\n"
+        "    Light lights[4];\n"
+        "    vec4 ambient;\n"
+        "    int lightCount;\n"
+        "};\n"
+        "layout(std140) uniform ObjectData {\n"
+        "    mat4 transform;\n"
+        "    mat3 normalMatrix;\n"
+        "    float specStr;\n"
+        "    float specPhong;\n"
+        "};\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = viewProj * transform * vec4(aPos, 1.0);\n"
+        "}\n";
+
+    const char* kFallbackFrag =
+        "#version 330 core\n"
+        "out vec4 FragColor;\n"
+        "void main()\n"
+        "{\n"
+        "    FragColor = vec4(0.5, 0.5, 0.5, 1.0);\n"
+        "}\n";
+}
+
+ShaderBuildQueue::ShaderBuildQueue(ProgramCache& cache)
+    : cache(cache), swaps(0)
+{
+    parallelCompile = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+    // tiny enough to build synchronously; everything else waits behind it
+    GLuint vertexShader = ShaderUtil::compile(GL_VERTEX_SHADER, kFallbackVert, "fallback");
+    GLuint fragShader = ShaderUtil::compile(GL_FRAGMENT_SHADER, kFallbackFrag, "fallback");
+    fallbackProgram = glCreateProgram();
+    glAttachShader(fallbackProgram, vertexShader);
+    glAttachShader(fallbackProgram, fragShader);
+    glLinkProgram(fallbackProgram);
+    glDetachShader(fallbackProgram, vertexShader);
+    glDetachShader(fallbackProgram, fragShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragShader);
+    ShaderUtil::checkLink(fallbackProgram, "fallback");
+
+    // the blocks above are written by hand, catch them drifting from the generated ones
+    const pair<const char*, GLint> blockSizes[] = {
+        { "FrameData", (GLint)sizeof(ShaderInterface::FrameData) },
+        { "ObjectData", (GLint)sizeof(ShaderInterface::ObjectData) },
+    };
+    for (const pair<const char*, GLint>& block : blockSizes) {
+        GLuint index = glGetUniformBlockIndex(fallbackProgram, block.first);
+        GLint size = 0;
+        if (index != GL_INVALID_INDEX)
+            glGetActiveUniformBlockiv(fallbackProgram, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        if (size != block.second)
+            cerr << "fallback " << block.first << " is " << size << " bytes, expected " << block.second << endl;
+    }
+}
+
+ShaderBuildQueue::Handle ShaderBuildQueue::submit(const ProgramSource& source)
+{
+    Build build;
+    build.source = source;
+    build.program = 0;
+    build.failed = false;
+    build.compiling = false;
+    build.pendingKey = 0;
+    build.pendingProgram = 0;
+    build.vertexShader = build.fragShader = build.computeShader = 0;
+
+    start(build, source);
+    builds.push_back(build);
+    return (Handle)builds.size() - 1;
+}
+
+void ShaderBuildQueue::rebuild(Handle handle, const ProgramSource& source)
+{
+    Build& build = builds[handle];
+    // a newer edit wins over a compile that is still running
+    dropPending(build);
+    start(build, source);
+}
+
+void ShaderBuildQueue::reload(const vector<string>& changedPaths)
+{
+    for (Handle handle = 0; handle < (Handle)builds.size(); handle++) {
+        const ProgramSource& current = builds[handle].source;
+        bool vertexChanged = find(changedPaths.begin(), changedPaths.end(), current.vertexPath) != changedPaths.end();
+        bool fragmentChanged = find(changedPaths.begin(), changedPaths.end(), current.fragmentPath) != changedPaths.end();
+        bool computeChanged = find(changedPaths.begin(), changedPaths.end(), current.computePath) != changedPaths.end();
+        if ((!vertexChanged || current.vertexPath.empty()) && (!fragmentChanged || current.fragmentPath.empty())
+            && (!computeChanged || current.computePath.empty()))
+            continue;
+
+        // every stage from disk, not just the changed one: an edit to another
+        // stage may only live in a build that is still compiling (or failed),
+        // and rebuild() drops that
+        ProgramSource source = current;
+        if (!source.vertexPath.empty())
+            source.vertex = ShaderUtil::readFile(source.vertexPath);
+        if (!source.fragmentPath.empty())
+            source.fragment = ShaderUtil::readFile(source.fragmentPath);
+        if (!source.computePath.empty())
+            source.compute = ShaderUtil::readFile(source.computePath);
+        cout << "reloading " << source.name << endl;
+        rebuild(handle, source);
+    }
+}
+
+void ShaderBuildQueue::start(Build& build, const ProgramSource& source)
+{
+    build.pendingSource = source;
+    build.pendingKey = cache.key(source);
+    build.pendingProgram = glCreateProgram();
+    build.compiling = true;
+
+    if (cache.load(build.pendingKey, build.pendingProgram)) {
+        swapIn(build);
+        return;
+    }
+
+    // a program that failed glProgramBinary can't be linked from source again
+    glDeleteProgram(build.pendingProgram);
+    build.pendingProgram = glCreateProgram();
+
+    if (cache.enabled())
+        glProgramParameteri(build.pendingProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    // issue everything without asking for a status, that is what would block
+    if (!source.compute.empty()) {
+        string comp = ShaderUtil::withDefines(source.compute, source.defines);
+        const char* c = comp.c_str();
+        build.computeShader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(build.computeShader, 1, &c, NULL);
+        glCompileShader(build.computeShader);
+        glAttachShader(build.pendingProgram, build.computeShader);
+        glLinkProgram(build.pendingProgram);
+        return;
+    }
+    string vert = ShaderUtil::withDefines(source.vertex, source.defines);
+    string frag = ShaderUtil::withDefines(source.fragment, source.defines);
+    const char* v = vert.c_str();
+    const char* f = frag.c_str();
+    build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(build.vertexShader, 1, &v, NULL);
+    glCompileShader(build.vertexShader);
+    build.fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(build.fragShader, 1, &f, NULL);
+    glCompileShader(build.fragShader);
+
+    glAttachShader(build.pendingProgram, build.vertexShader);
+    glAttachShader(build.pendingProgram, build.fragShader);
+    glLinkProgram(build.pendingProgram);
+}
+
+void ShaderBuildQueue::poll()
+{
+    for (Build& build : builds) {
+        if (!build.compiling)
+            continue;
+        if (parallelCompile) {
+            GLint done = GL_FALSE;
+            glGetProgramiv(build.pendingProgram, GL_COMPLETION_STATUS_KHR, &done);
+            if (done)
+                finish(build);
+        }
+        else {
+            // no way to ask without blocking: take the stall for one program per frame
+            finish(build);
+            return;
+        }
+    }
+}
+
+void ShaderBuildQueue::finish(Build& build)
+{
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(build.pendingProgram, GL_LINK_STATUS, &isLinked);
+    if (!isLinked) {
+        // the per stage logs say more than the link log
+        if (build.computeShader) {
+            ShaderUtil::checkCompile(build.computeShader, GL_COMPUTE_SHADER, build.pendingSource.name);
+        }
+        else {
+            ShaderUtil::checkCompile(build.vertexShader, GL_VERTEX_SHADER, build.pendingSource.name);
+            ShaderUtil::checkCompile(build.fragShader, GL_FRAGMENT_SHADER, build.pendingSource.name);
+        }
+        ShaderUtil::checkLink(build.pendingProgram, build.pendingSource.name);
+        // a broken edit keeps the last good program on screen
+        if (!build.program)
+            build.failed = true;
+        dropPending(build);
+        return;
+    }
+
+    cache.store(build.pendingKey, build.pendingProgram);
+    swapIn(build);
+}
+
+void ShaderBuildQueue::swapIn(Build& build)
+{
+    // the linked program keeps what it needs from the shader objects
+    if (build.vertexShader) {
+        glDetachShader(build.pendingProgram, build.vertexShader);
+        glDetachShader(build.pendingProgram, build.fragShader);
+    }
+    if (build.computeShader)
+        glDetachShader(build.pendingProgram, build.computeShader);
+    if (build.program) {
+        UniformTable::forget(build.program);
+        glDeleteProgram(build.program);
+        swaps++;
+    }
+    // block bindings are link state, a relink or a binary load resets them
+    applyBlockBindings(build.pendingProgram);
+    build.program = build.pendingProgram;
+    build.source = build.pendingSource;
+    build.failed = false;
+    build.pendingProgram = 0;
+    dropPending(build);
+}
+
+void ShaderBuildQueue::dropPending(Build& build)
+{
+    if (build.pendingProgram) {
+        glDeleteProgram(build.pendingProgram);
+        build.pendingProgram = 0;
+    }
+    // deleting a shader that is still attached only flags it, the program cleans it up
+    glDeleteShader(build.vertexShader);
+    glDeleteShader(build.fragShader);
+    glDeleteShader(build.computeShader);
+    build.vertexShader = build.fragShader = build.computeShader = 0;
+    build.compiling = false;
+}
+
+void ShaderBuildQueue::bindBlock(const string& name, GLuint binding)
+{
+    blockBindings.push_back(make_pair(name, binding));
+    applyBlockBindings(fallbackProgram);
+    for (const Build& build : builds) {
+        if (build.program)
+            applyBlockBindings(build.program);
+    }
+}
+
+void ShaderBuildQueue::applyBlockBindings(GLuint program) const
+{
+    for (const pair<string, GLuint>& block : blockBindings) {
+        GLuint index = glGetUniformBlockIndex(program, block.first.c_str());
+        // stages that don't use the block simply don't have it
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.second);
+    }
+}
+
+GLuint ShaderBuildQueue::program(Handle handle) const
+{
+    const Build& build = builds[handle];
+    return build.program ? build.program : fallbackProgram;
+}
+
+bool ShaderBuildQueue::ready(Handle handle) const
+{
+    return builds[handle].program != 0;
+}
+
+bool ShaderBuildQueue::failed(Handle handle) const
+{
+    return builds[handle].failed;
+}
+
+int ShaderBuildQueue::pendingCount() const
+{
+    int count = 0;
+    for (const Build& build : builds) {
+        if (build.compiling)
+            count++;
+    }
+    return count;
+}
+
+void ShaderBuildQueue::release()
+{
+    for (Build& build : builds) {
+        dropPending(build);
+        UniformTable::forget(build.program);
+        glDeleteProgram(build.program);
+        build.program = 0;
+    }
+    builds.clear();
+    UniformTable::forget(fallbackProgram);
+    glDeleteProgram(fallbackProgram);
+    fallbackProgram = 0;
+}
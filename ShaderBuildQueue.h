@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+#include "ProgramCache.h"
+
+// submits every compile and link up front and hands out programs once they
+// are done; with GL_KHR_parallel_shader_compile the driver compiles on its own
+// threads and completion is polled, otherwise one program is finished per
+// frame. Until then program() returns a flat shaded fallback.
+// Rebuilds (hot reload) compile next to the live program, which keeps being
+// handed out until the new one has linked and is swapped in.
+// Compute programs (ProgramSource::compute) build the same way; the
+// fallback can't stand in for them, so check ready() before dispatching.
+class ShaderBuildQueue
+{
+public:
+    typedef int Handle;
+
+    explicit ShaderBuildQueue(ProgramCache& cache);
+
+    // restore from the binary cache or start compiling; never waits on the driver
+    Handle submit(const ProgramSource& source);
+    // compile new sources for an existing program and swap them in once linked
+    void rebuild(Handle handle, const ProgramSource& source);
+    // re-read and rebuild every program that uses one of the changed files
+    void reload(const std::vector<std::string>& changedPaths);
+    // finish programs the driver is done with; call once per frame
+    void poll();
+
+    // the linked program, or the fallback while it is still compiling
+    GLuint program(Handle handle) const;
+    bool ready(Handle handle) const;
+    // the first build failed; program() keeps returning the fallback
+    bool failed(Handle handle) const;
+    int pendingCount() const;
+    // programs swapped in by rebuilds so far
+    unsigned int swapCount() const { return swaps; }
+    bool parallel() const { return parallelCompile; }
+
+    GLuint fallback() const { return fallbackProgram; }
+
+    // point the named uniform block of every program (current, fallback and
+    // later ones) at a fixed binding point
+    void bindBlock(const std::string& name, GLuint binding);
+
+    void release();
+
+private:
+    struct Build {
+        // sources of the live program
+        ProgramSource source;
+        // live program, 0 until the first link succeeded
+        GLuint program;
+        bool failed;
+
+        // in-flight compile, either the first one or a rebuild
+        bool compiling;
+        ProgramSource pendingSource;
+        uint64_t pendingKey;
+        GLuint pendingProgram;
+        GLuint vertexShader, fragShader, computeShader;
+    };
+
+    void start(Build& build, const ProgramSource& source);
+    void finish(Build& build);
+    void swapIn(Build& build);
+    void dropPending(Build& build);
+    void applyBlockBindings(GLuint program) const;
+
+    ProgramCache& cache;
+    std::vector<Build> builds;
+    GLuint fallbackProgram;
+    std::vector<std::pair<std::string, GLuint>> blockBindings;
+    bool parallelCompile;
+    unsigned int swaps;
+};
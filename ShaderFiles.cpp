@@ -0,0 +1,35 @@
+#include "ShaderFiles.h"
+#include "ProgramCache.h"
+#include "ShaderSources.h"
+
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+ShaderFiles::ShaderFiles(const string& overrideDirectory)
+    : directory(overrideDirectory)
+{
+    while (!directory.empty() && (directory.back() == '/' || directory.back() == '\\'))
+        directory.pop_back();
+}
+
+string ShaderFiles::path(const string& name) const
+{
+    return (overridden() ? directory : string("Shaders")) + "/" + name;
+}
+
+string ShaderFiles::read(const string& path) const
+{
+    if (overridden())
+        return ShaderUtil::readFile(path);
+
+    size_t slash = path.find_last_of("/\\");
+    string name = slash == string::npos ? path : path.substr(slash + 1);
+    for (const ShaderSources::File& file : ShaderSources::kFiles) {
+        if (strcmp(file.name, name.c_str()) == 0)
+            return file.source;
+    }
+    cerr << "no embedded shader " << name << endl;
+    return "";
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+// where the GLSL sources come from
+// by default the copies ShaderGen embedded at build time (ShaderSources.h),
+// so startup reads no files and doesn't depend on the working directory;
+// with an override directory they are read from there instead, which is
+// what hot reload needs
+class ShaderFiles
+{
+public:
+    // empty directory = embedded sources only
+    explicit ShaderFiles(const std::string& overrideDirectory = "");
+
+    bool overridden() const { return !directory.empty(); }
+    // path a shader is known by: <override>/<name>, or Shaders/<name> when embedded
+    std::string path(const std::string& name) const;
+    // source of a path returned by path(); empty if there is none
+    std::string read(const std::string& path) const;
+
+private:
+    std::string directory;
+};
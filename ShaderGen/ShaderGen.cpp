@@ -0,0 +1,810 @@
+// build step that reads the GLSL sources and writes ShaderInterface.h:
+// std140 mirrors of every uniform block (with offset asserts), block binding
+// points, vertex attribute locations, sampler texture units and the names of
+// the remaining loose uniforms, so the C++ side can't drift from the shaders
+// with --embed it also writes the sources themselves as string constants, so
+// the program doesn't read shader files at startup
+//
+// usage: ShaderGen <output.h> [--embed <sources.h>] <program> <vertex> <fragment> [<program> <vertex> <fragment> ...]
+// a compute program is <program> <compute.comp>, its one stage takes the place of both
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace {
+    struct Member {
+        string type;
+        string name;
+        // 0 = not an array
+        int arraySize;
+        int line;
+    };
+
+    struct Block {
+        string name;
+        vector<Member> members;
+        int binding;
+        // first declaration, for error messages
+        string file;
+        int line;
+    };
+
+    struct Struct {
+        string name;
+        vector<Member> members;
+    };
+
+    struct Attribute {
+        string name;
+        int location;
+    };
+
+    struct Uniform {
+        string type;
+        string name;
+    };
+
+    struct Program {
+        string name;
+        vector<Attribute> attributes;
+        vector<Uniform> samplers;
+        vector<Uniform> uniforms;
+        vector<string> blocks;
+    };
+
+    struct Token {
+        string text;
+        int line;
+    };
+
+    // std140 size / base alignment of a type and the C++ type that matches it
+    struct Layout {
+        int size;
+        int align;
+        string cppType;
+    };
+
+    map<string, Struct> structs;
+    vector<string> structOrder;
+    // file name -> text of every shader read, for --embed
+    map<string, string> sources;
+    map<string, Block> blocks;
+    vector<string> blockOrder;
+    bool failed = false;
+
+    void error(const string& file, int line, const string& message)
+    {
+        // file(line): error: the format the IDE error list picks up
+        cerr << file << "(" << line << "): error: " << message << endl;
+        failed = true;
+    }
+
+    int roundUp(int value, int alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // strips comments and preprocessor lines; #define NAME <int> is kept for array sizes
+    vector<Token> tokenize(const string& source, map<string, int>& constants)
+    {
+        vector<Token> tokens;
+        int line = 1;
+        bool lineStart = true;
+        size_t i = 0;
+        while (i < source.size()) {
+            char c = source[i];
+            if (c == '\n') {
+                line++;
+                lineStart = true;
+                i++;
+                continue;
+            }
+            if (isspace((unsigned char)c)) {
+                i++;
+                continue;
+            }
+            if (c == '/' && i + 1 < source.size() && source[i + 1] == '/') {
+                while (i < source.size() && source[i] != '\n')
+                    i++;
+                continue;
+            }
+            if (c == '/' && i + 1 < source.size() && source[i + 1] == '*') {
+                i += 2;
+                while (i + 1 < source.size() && !(source[i] == '*' && source[i + 1] == '/')) {
+                    if (source[i] == '\n')
+                        line++;
+                    i++;
+                }
+                i += 2;
+                continue;
+            }
+            if (c == '#' && lineStart) {
+                size_t end = source.find('\n', i);
+                string directive = source.substr(i, end == string::npos ? string::npos : end - i);
+                istringstream words(directive.substr(1));
+                string keyword, name, value;
+                words >> keyword >> name >> value;
+                if (keyword == "define" && !value.empty() && isdigit((unsigned char)value[0]))
+                    constants[name] = atoi(value.c_str());
+                i = end == string::npos ? source.size() : end;
+                continue;
+            }
+            lineStart = false;
+
+            Token token;
+            token.line = line;
+            if (isalnum((unsigned char)c) || c == '_') {
+                size_t start = i;
+                while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_' || source[i] == '.'))
+                    i++;
+                token.text = source.substr(start, i - start);
+            }
+            else {
+                token.text = string(1, c);
+                i++;
+            }
+            tokens.push_back(token);
+        }
+        return tokens;
+    }
+
+    bool isSampler(const string& type)
+    {
+        return type.find("sampler") != string::npos;
+    }
+
+    bool isQualifier(const string& word)
+    {
+        static const char* qualifiers[] = {
+            "highp", "mediump", "lowp", "flat", "smooth", "noperspective", "centroid", "invariant", "precise"
+        };
+        for (const char* qualifier : qualifiers) {
+            if (word == qualifier)
+                return true;
+        }
+        return false;
+    }
+
+    bool layoutOf(const string& type, Layout& layout)
+    {
+        // bool is 4 bytes in std140
+        static const map<string, Layout> scalars = {
+            { "float", { 4, 4, "float" } },
+            { "int", { 4, 4, "int" } },
+            { "uint", { 4, 4, "unsigned int" } },
+            { "bool", { 4, 4, "int" } },
+        };
+        auto scalar = scalars.find(type);
+        if (scalar != scalars.end()) {
+            layout = scalar->second;
+            return true;
+        }
+
+        // vecN / ivecN / uvecN / bvecN
+        size_t vec = type.find("vec");
+        if (vec != string::npos && vec + 4 == type.size()) {
+            string prefix = type.substr(0, vec);
+            int n = type[vec + 3] - '0';
+            if (n < 2 || n > 4 || (prefix != "" && prefix != "i" && prefix != "u" && prefix != "b"))
+                return false;
+            string glmPrefix = prefix == "" ? "" : prefix == "u" ? "u" : "i";
+            layout.size = 4 * n;
+            layout.align = n == 2 ? 8 : 16;
+            layout.cppType = "glm::" + glmPrefix + "vec" + to_string(n);
+            return true;
+        }
+
+        // matC / matCxR: C columns of vecR, every column padded to a vec4
+        if (type.compare(0, 3, "mat") == 0) {
+            int columns = 0, rows = 0;
+            if (type.size() == 4) {
+                columns = rows = type[3] - '0';
+            }
+            else if (type.size() == 6 && type[4] == 'x') {
+                columns = type[3] - '0';
+                rows = type[5] - '0';
+            }
+            if (columns < 2 || columns > 4 || rows < 2 || rows > 4)
+                return false;
+            layout.size = 16 * columns;
+            layout.align = 16;
+            if (rows == 4)
+                layout.cppType = columns == 4 ? "glm::mat4" : "glm::mat" + to_string(columns) + "x4";
+            else if (columns == rows)
+                layout.cppType = "Std140Mat<" + to_string(columns) + ">";
+            else
+                return false;
+            return true;
+        }
+
+        auto found = structs.find(type);
+        if (found != structs.end()) {
+            int offset = 0, align = 16;
+            for (const Member& member : found->second.members) {
+                Layout memberLayout;
+                if (!layoutOf(member.type, memberLayout))
+                    return false;
+                int memberAlign = member.arraySize ? roundUp(memberLayout.align, 16) : memberLayout.align;
+                int memberSize = member.arraySize ? roundUp(memberLayout.size, 16) * member.arraySize : memberLayout.size;
+                offset = roundUp(offset, memberAlign) + memberSize;
+                align = max(align, memberAlign);
+            }
+            layout.size = roundUp(offset, align);
+            layout.align = align;
+            layout.cppType = type;
+            return true;
+        }
+        return false;
+    }
+
+    class Parser {
+    public:
+        Parser(const string& file, const vector<Token>& tokens, const map<string, int>& constants)
+            : file(file), tokens(tokens), constants(constants), pos(0)
+        {
+        }
+
+        void parse(Program& program, bool vertexStage)
+        {
+            while (pos < tokens.size()) {
+                if (peek() == "struct") {
+                    parseStruct();
+                    continue;
+                }
+
+                // layout(...) and storage qualifiers in front of a declaration
+                int location = -1, binding = -1;
+                bool std140 = false;
+                string storage;
+                size_t start = pos;
+                while (pos < tokens.size()) {
+                    if (peek() == "layout") {
+                        parseLayout(location, binding, std140);
+                    }
+                    else if (peek() == "uniform" || peek() == "in" || peek() == "out" || peek() == "const") {
+                        storage = next().text;
+                    }
+                    else if (isQualifier(peek())) {
+                        pos++;
+                    }
+                    else {
+                        break;
+                    }
+                }
+
+                if (storage == "uniform") {
+                    parseUniform(program, binding, std140);
+                }
+                else if (storage == "in" && vertexStage) {
+                    parseAttribute(program, location);
+                }
+                else {
+                    if (pos == start && pos < tokens.size())
+                        pos++;
+                    skipStatement();
+                }
+            }
+        }
+
+    private:
+        const string& peek(size_t ahead = 0) const
+        {
+            static const string end;
+            return pos + ahead < tokens.size() ? tokens[pos + ahead].text : end;
+        }
+
+        const Token& next()
+        {
+            static const Token end = { "", 0 };
+            return pos < tokens.size() ? tokens[pos++] : end;
+        }
+
+        int line() const
+        {
+            if (tokens.empty())
+                return 0;
+            return tokens[min(pos, tokens.size() - 1)].line;
+        }
+
+        bool expect(const string& text)
+        {
+            if (peek() == text) {
+                pos++;
+                return true;
+            }
+            error(file, line(), "expected '" + text + "' but found '" + peek() + "'");
+            return false;
+        }
+
+        // skip to the end of the statement, or over a function body
+        void skipStatement()
+        {
+            int depth = 0;
+            while (pos < tokens.size()) {
+                const string& text = next().text;
+                if (text == "{" || text == "(")
+                    depth++;
+                else if (text == ")")
+                    depth--;
+                else if (text == "}") {
+                    if (--depth == 0 && peek() != ";")
+                        return;
+                }
+                else if (text == ";" && depth == 0)
+                    return;
+            }
+        }
+
+        void parseLayout(int& location, int& binding, bool& std140)
+        {
+            pos++;
+            if (!expect("("))
+                return;
+            while (pos < tokens.size() && peek() != ")") {
+                string key = next().text;
+                int value = -1;
+                if (peek() == "=") {
+                    pos++;
+                    value = atoi(next().text.c_str());
+                }
+                if (key == "location")
+                    location = value;
+                else if (key == "binding")
+                    binding = value;
+                else if (key == "std140")
+                    std140 = true;
+                if (peek() == ",")
+                    pos++;
+            }
+            expect(")");
+        }
+
+        int parseArraySize()
+        {
+            if (peek() != "[")
+                return 0;
+            pos++;
+            string size = next().text;
+            expect("]");
+            if (!size.empty() && isdigit((unsigned char)size[0]))
+                return atoi(size.c_str());
+            auto constant = constants.find(size);
+            if (constant != constants.end())
+                return constant->second;
+            error(file, line(), "array size '" + size + "' has to be a literal or a #define");
+            return 1;
+        }
+
+        // type name[N], name2;
+        void parseMembers(vector<Member>& members)
+        {
+            if (!expect("{"))
+                return;
+            while (pos < tokens.size() && peek() != "}") {
+                while (isQualifier(peek()))
+                    pos++;
+                Member member;
+                member.line = line();
+                member.type = next().text;
+                do {
+                    member.name = next().text;
+                    member.arraySize = parseArraySize();
+                    members.push_back(member);
+                } while (peek() == "," && next().text == ",");
+                expect(";");
+            }
+            expect("}");
+        }
+
+        void parseStruct()
+        {
+            pos++;
+            Struct declared;
+            int declaredLine = line();
+            declared.name = next().text;
+            parseMembers(declared.members);
+            skipStatement();
+
+            auto existing = structs.find(declared.name);
+            if (existing == structs.end()) {
+                structs[declared.name] = declared;
+                structOrder.push_back(declared.name);
+            }
+            else if (!sameMembers(existing->second.members, declared.members)) {
+                error(file, declaredLine, "struct " + declared.name + " doesn't match an earlier declaration");
+            }
+        }
+
+        void parseUniform(Program& program, int binding, bool std140)
+        {
+            // uniform Name { ... } [instance];
+            if (peek(1) == "{") {
+                Block declared;
+                declared.line = line();
+                declared.file = file;
+                declared.name = next().text;
+                declared.binding = binding;
+                parseMembers(declared.members);
+                if (peek() != ";")
+                    error(file, line(), "instanced block " + declared.name + " isn't supported, declare it without an instance name");
+                skipStatement();
+                if (!std140)
+                    error(file, declared.line, "block " + declared.name + " needs layout(std140) to be mirrored in C++");
+
+                auto existing = blocks.find(declared.name);
+                if (existing == blocks.end()) {
+                    blocks[declared.name] = declared;
+                    blockOrder.push_back(declared.name);
+                }
+                else if (!sameMembers(existing->second.members, declared.members)) {
+                    error(file, declared.line, "block " + declared.name + " doesn't match the declaration in "
+                        + existing->second.file + "(" + to_string(existing->second.line) + ")");
+                }
+                if (find(program.blocks.begin(), program.blocks.end(), declared.name) == program.blocks.end())
+                    program.blocks.push_back(declared.name);
+                return;
+            }
+
+            // uniform type name[N];
+            Uniform uniform;
+            uniform.type = next().text;
+            do {
+                uniform.name = next().text;
+                parseArraySize();
+                vector<Uniform>& list = isSampler(uniform.type) ? program.samplers : program.uniforms;
+                auto same = find_if(list.begin(), list.end(), [&](const Uniform& u) { return u.name == uniform.name; });
+                if (same == list.end())
+                    list.push_back(uniform);
+                else if (same->type != uniform.type)
+                    error(file, line(), "uniform " + uniform.name + " is declared as " + same->type + " in the other stage");
+            } while (peek() == "," && next().text == ",");
+            skipStatement();
+        }
+
+        void parseAttribute(Program& program, int location)
+        {
+            next();
+            Attribute attribute;
+            attribute.name = next().text;
+            attribute.location = location;
+            if (location < 0)
+                error(file, line(), "vertex input " + attribute.name + " needs an explicit layout(location)");
+            program.attributes.push_back(attribute);
+            skipStatement();
+        }
+
+        static bool sameMembers(const vector<Member>& a, const vector<Member>& b)
+        {
+            if (a.size() != b.size())
+                return false;
+            for (size_t i = 0; i < a.size(); i++) {
+                if (a[i].type != b[i].type || a[i].name != b[i].name || a[i].arraySize != b[i].arraySize)
+                    return false;
+            }
+            return true;
+        }
+
+        string file;
+        const vector<Token>& tokens;
+        const map<string, int>& constants;
+        size_t pos;
+    };
+
+    string fileName(const string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == string::npos ? path : path.substr(slash + 1);
+    }
+
+    bool parseFile(const string& path, Program& program, bool vertexStage)
+    {
+        ifstream in(path, ios::binary);
+        if (!in) {
+            error(path, 0, "can't open the shader");
+            return false;
+        }
+        string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        text.erase(remove(text.begin(), text.end(), '\r'), text.end());
+        sources[fileName(path)] = text;
+        map<string, int> constants;
+        vector<Token> tokens = tokenize(text, constants);
+        Parser parser(path, tokens, constants);
+        parser.parse(program, vertexStage);
+        return true;
+    }
+
+    string namespaceName(const string& program)
+    {
+        string name = program;
+        if (!name.empty())
+            name[0] = (char)toupper((unsigned char)name[0]);
+        return name;
+    }
+
+    // struct body with explicit padding so the C++ layout is the std140 layout
+    void writeStruct(ostream& out, const string& name, const vector<Member>& members, const string& file)
+    {
+        vector<pair<string, int>> offsets;
+        out << "    struct " << name << " {\n";
+        int offset = 0, cppOffset = 0, paddings = 0, align = 16;
+        for (const Member& member : members) {
+            Layout layout;
+            if (!layoutOf(member.type, layout)) {
+                error(file, member.line, "type " + member.type + " of " + member.name + " has no std140 mirror");
+                continue;
+            }
+            string cppType = layout.cppType;
+            int memberAlign = layout.align, memberSize = layout.size;
+            if (member.arraySize) {
+                // array elements are padded out to a vec4
+                int stride = roundUp(layout.size, 16);
+                if (stride != layout.size)
+                    cppType = "Std140Padded<" + cppType + ", " + to_string((stride - layout.size) / 4) + ">";
+                memberAlign = roundUp(layout.align, 16);
+                memberSize = stride * member.arraySize;
+            }
+            align = max(align, memberAlign);
+            offset = roundUp(offset, memberAlign);
+            if (offset > cppOffset)
+                out << "        float padding" << paddings++ << "[" << (offset - cppOffset) / 4 << "];\n";
+            out << "        " << cppType << " " << member.name;
+            if (member.arraySize)
+                out << "[" << member.arraySize << "]";
+            out << ";\n";
+            offsets.push_back(make_pair(member.name, offset));
+            offset += memberSize;
+            cppOffset = offset;
+        }
+        int size = roundUp(offset, align);
+        if (size > cppOffset)
+            out << "        float padding" << paddings++ << "[" << (size - cppOffset) / 4 << "];\n";
+        out << "    };\n";
+        for (const pair<string, int>& member : offsets) {
+            out << "    static_assert(offsetof(" << name << ", " << member.first << ") == " << member.second
+                << ", \"std140 offset of " << name << "::" << member.first << "\");\n";
+        }
+        out << "    static_assert(sizeof(" << name << ") == " << size << ", \"std140 size of " << name << "\");\n\n";
+    }
+
+    string generate(const vector<Program>& programs)
+    {
+        ostringstream out;
+        out << "// generated by ShaderGen from the GLSL sources, don't edit\n"
+            << "#pragma once\n\n"
+            << "#include <cstddef>\n"
+            << "#include <glad/glad.h>\n"
+            << "#include <glm/glm.hpp>\n\n"
+            << "namespace ShaderInterface {\n"
+            << "    // array element smaller than a vec4, std140 pads it out\n"
+            << "    template<typename T, int Pad>\n"
+            << "    struct Std140Padded {\n"
+            << "        T value;\n"
+            << "        float padding[Pad];\n"
+            << "        Std140Padded& operator=(const T& v) { value = v; return *this; }\n"
+            << "    };\n\n"
+            << "    // square matrix whose columns are padded out to a vec4\n"
+            << "    template<int N>\n"
+            << "    struct Std140Mat {\n"
+            << "        glm::vec4 columns[N];\n"
+            << "        template<typename M>\n"
+            << "        Std140Mat& operator=(const M& m)\n"
+            << "        {\n"
+            << "            for (int c = 0; c < N; c++) {\n"
+            << "                columns[c] = glm::vec4(0.f);\n"
+            << "                for (int r = 0; r < N; r++)\n"
+            << "                    columns[c][r] = m[c][r];\n"
+            << "            }\n"
+            << "            return *this;\n"
+            << "        }\n"
+            << "    };\n\n";
+
+        for (const string& name : structOrder) {
+            const Struct& declared = structs[name];
+            writeStruct(out, name, declared.members, "struct " + name);
+        }
+
+        // bindings: explicit layout(binding) wins, the rest in order of first use
+        int nextBinding = 0;
+        for (const string& name : blockOrder) {
+            if (blocks[name].binding >= 0)
+                nextBinding = max(nextBinding, blocks[name].binding + 1);
+        }
+        for (const string& name : blockOrder) {
+            Block& block = blocks[name];
+            if (block.binding < 0)
+                block.binding = nextBinding++;
+            writeStruct(out, name, block.members, block.file);
+        }
+
+        out << "    // uniform buffer binding point of each block\n"
+            << "    namespace Binding {\n"
+            << "        enum : GLuint {\n";
+        for (const string& name : blockOrder)
+            out << "            " << name << " = " << blocks[name].binding << ",\n";
+        out << "        };\n"
+            << "    }\n\n"
+            << "    struct BlockBinding {\n"
+            << "        const char* name;\n"
+            << "        GLuint binding;\n"
+            << "    };\n"
+            << "    const BlockBinding kBlockBindings[] = {\n";
+        for (const string& name : blockOrder)
+            out << "        { \"" << name << "\", Binding::" << name << " },\n";
+        out << "    };\n";
+
+        for (const Program& program : programs) {
+            out << "\n    // " << program.name << " program\n"
+                << "    namespace " << namespaceName(program.name) << " {\n";
+            if (!program.attributes.empty()) {
+                vector<Attribute> attributes = program.attributes;
+                sort(attributes.begin(), attributes.end(), [](const Attribute& a, const Attribute& b) { return a.location < b.location; });
+                out << "        // vertex attribute locations\n"
+                    << "        namespace Attrib {\n"
+                    << "            enum : GLuint {\n";
+                for (const Attribute& attribute : attributes)
+                    out << "                " << attribute.name << " = " << attribute.location << ",\n";
+                out << "            };\n"
+                    << "        }\n";
+            }
+            if (!program.samplers.empty()) {
+                out << "        // texture unit of each sampler, in declaration order\n"
+                    << "        namespace Unit {\n"
+                    << "            enum : GLint {\n";
+                for (size_t i = 0; i < program.samplers.size(); i++)
+                    out << "                " << program.samplers[i].name << " = " << i << ",\n";
+                out << "            };\n"
+                    << "        }\n";
+            }
+            if (!program.samplers.empty() || !program.uniforms.empty()) {
+                out << "        // names of the uniforms outside of blocks\n"
+                    << "        namespace Uniform {\n";
+                for (const Uniform& uniform : program.samplers)
+                    out << "            constexpr const char* " << uniform.name << " = \"" << uniform.name << "\";\n";
+                for (const Uniform& uniform : program.uniforms)
+                    out << "            constexpr const char* " << uniform.name << " = \"" << uniform.name << "\";\n";
+                out << "        }\n";
+            }
+            out << "    }\n";
+        }
+        out << "}\n";
+        return out.str();
+    }
+
+    // sample.vert -> sample_vert
+    string identifier(const string& name)
+    {
+        string id = name;
+        for (char& c : id) {
+            if (!isalnum((unsigned char)c))
+                c = '_';
+        }
+        return id;
+    }
+
+    // one literal per line; adjacent literals are joined by the compiler and
+    // none of them gets near MSVC's length limit for a single literal
+    void writeLiteral(ostream& out, const string& text)
+    {
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            end = end == string::npos ? text.size() : end + 1;
+            out << "        \"";
+            for (size_t i = start; i < end; i++) {
+                char c = text[i];
+                if (c == '\n')
+                    out << "\\n";
+                else if (c == '\t')
+                    out << "\\t";
+                else if (c == '"' || c == '\\')
+                    out << '\\' << c;
+                else
+                    out << c;
+            }
+            out << "\"\n";
+            start = end;
+        }
+        if (text.empty())
+            out << "        \"\"\n";
+    }
+
+    string generateSources()
+    {
+        ostringstream out;
+        out << "// generated by ShaderGen from the GLSL sources, don't edit\n"
+            << "#pragma once\n\n"
+            << "namespace ShaderSources {\n"
+            << "    struct File {\n"
+            << "        const char* name;\n"
+            << "        const char* source;\n"
+            << "    };\n\n";
+        for (const pair<const string, string>& source : sources) {
+            out << "    constexpr char " << identifier(source.first) << "[] =\n";
+            writeLiteral(out, source.second);
+            out << "        ;\n\n";
+        }
+        out << "    constexpr File kFiles[] = {\n";
+        for (const pair<const string, string>& source : sources)
+            out << "        { \"" << source.first << "\", " << identifier(source.first) << " },\n";
+        out << "    };\n"
+            << "}\n";
+        return out.str();
+    }
+
+    // leave the file alone when nothing changed so dependents don't rebuild
+    bool writeIfChanged(const string& output, const string& text)
+    {
+        ifstream existing(output, ios::binary);
+        stringstream current;
+        current << existing.rdbuf();
+        if (existing && current.str() == text) {
+            cout << "ShaderGen: " << output << " is up to date" << endl;
+            return true;
+        }
+        existing.close();
+
+        ofstream out(output, ios::binary);
+        out << text;
+        if (!out) {
+            error(output, 0, "can't write the header");
+            return false;
+        }
+        cout << "ShaderGen: wrote " << output << endl;
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int first = 2;
+    string embedOutput;
+    if (argc > 3 && string(argv[2]) == "--embed") {
+        embedOutput = argv[3];
+        first = 4;
+    }
+    const char* usage = "usage: ShaderGen <output.h> [--embed <sources.h>] <program> <vertex> <fragment> | <program> <compute.comp> ...";
+    if (argc < first + 2) {
+        cerr << usage << endl;
+        return 1;
+    }
+
+    vector<Program> programs;
+    for (int i = first; i < argc;) {
+        Program program;
+        program.name = argv[i];
+        string stage = i + 1 < argc ? argv[i + 1] : "";
+        if (stage.size() > 5 && stage.compare(stage.size() - 5, 5, ".comp") == 0) {
+            parseFile(stage, program, false);
+            i += 2;
+        }
+        else if (i + 2 < argc) {
+            parseFile(argv[i + 1], program, true);
+            parseFile(argv[i + 2], program, false);
+            i += 3;
+        }
+        else {
+            cerr << usage << endl;
+            return 1;
+        }
+        programs.push_back(program);
+    }
+    string header = generate(programs);
+    if (failed)
+        return 1;
+
+    if (!writeIfChanged(argv[1], header))
+        return 1;
+    if (!embedOutput.empty() && !writeIfChanged(embedOutput, generateSources()))
+        return 1;
+    return 0;
+}
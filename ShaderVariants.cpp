@@ -0,0 +1,100 @@
+#include "ShaderVariants.h"
+
+#include <algorithm>
+#include <bitset>
+
+using namespace std;
+
+ShaderVariants::ShaderVariants(ShaderBuildQueue& queue, const ProgramSource& base, const char* const* featureNames, int featureCount)
+    : queue(queue), base(base), featureNames(featureNames, featureNames + featureCount), harmless(0)
+{
+    variants.resize((size_t)1 << featureCount);
+    for (Variant& variant : variants)
+        variant.handle = -1;
+}
+
+ShaderBuildQueue::Handle ShaderVariants::handle(unsigned int features)
+{
+    Variant& variant = variants[features];
+    if (variant.handle < 0) {
+        ProgramSource source = base;
+        source.name = base.name + "[" + name(features) + "]";
+        for (int bit = 0; bit < featureCount(); bit++) {
+            if (features & (1u << bit))
+                source.defines += "#define " + featureNames[bit] + "\n";
+        }
+        variant.handle = queue.submit(source);
+    }
+    return variant.handle;
+}
+
+void ShaderVariants::prepare(unsigned int features)
+{
+    handle(features);
+}
+
+GLuint ShaderVariants::program(unsigned int features)
+{
+    ShaderBuildQueue::Handle exact = handle(features);
+    if (queue.ready(exact))
+        return queue.program(exact);
+
+    // the stand-in with the fewest extra features is the cheapest one
+    int best = -1;
+    size_t bestBits = 0;
+    for (unsigned int other = 0; other < variants.size(); other++) {
+        const Variant& variant = variants[other];
+        if ((other & features) != features || (other & ~features & ~harmless) != 0)
+            continue;
+        if (variant.handle < 0 || !queue.ready(variant.handle))
+            continue;
+        size_t bits = bitset<32>(other).count();
+        if (best < 0 || bits < bestBits) {
+            best = (int)other;
+            bestBits = bits;
+        }
+    }
+    return best >= 0 ? queue.program(variants[best].handle) : queue.program(exact);
+}
+
+bool ShaderVariants::ready(unsigned int features) const
+{
+    const Variant& variant = variants[features];
+    return variant.handle >= 0 && queue.ready(variant.handle);
+}
+
+UniformTable& ShaderVariants::uniforms(unsigned int features)
+{
+    return variants[features].uniforms;
+}
+
+void ShaderVariants::reload(const vector<string>& changedPaths)
+{
+    if (!base.vertexPath.empty() && find(changedPaths.begin(), changedPaths.end(), base.vertexPath) != changedPaths.end())
+        base.vertex = ShaderUtil::readFile(base.vertexPath);
+    if (!base.fragmentPath.empty() && find(changedPaths.begin(), changedPaths.end(), base.fragmentPath) != changedPaths.end())
+        base.fragment = ShaderUtil::readFile(base.fragmentPath);
+}
+
+string ShaderVariants::name(unsigned int features) const
+{
+    string result;
+    for (int bit = 0; bit < featureCount(); bit++) {
+        if (!(features & (1u << bit)))
+            continue;
+        if (!result.empty())
+            result += "|";
+        result += featureNames[bit];
+    }
+    return result.empty() ? "base" : result;
+}
+
+int ShaderVariants::builtCount() const
+{
+    int count = 0;
+    for (const Variant& variant : variants) {
+        if (variant.handle >= 0)
+            count++;
+    }
+    return count;
+}
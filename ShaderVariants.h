@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ShaderBuildQueue.h"
+#include "UniformTable.h"
+
+// specialized builds of one program, one per combination of feature bits
+// each bit becomes a #define; a variant is only submitted to the build queue
+// the first time something asks for it and the binary cache keeps it across
+// runs. While a variant compiles, program() can hand out a ready variant that
+// only adds features marked as harmless (ones that don't change the result
+// when their inputs are neutral, like a specular strength of 0).
+class ShaderVariants
+{
+public:
+    ShaderVariants(ShaderBuildQueue& queue, const ProgramSource& base, const char* const* featureNames, int featureCount);
+
+    // features a stand-in variant may add on top of the requested ones
+    void setHarmlessFeatures(unsigned int features) { harmless = features; }
+
+    // start compiling a variant ahead of the first draw that needs it
+    void prepare(unsigned int features);
+    // the variant's program, a ready stand-in while it compiles, else the queue's fallback
+    GLuint program(unsigned int features);
+    bool ready(unsigned int features) const;
+    // reflected uniforms of draws using this feature set, bound to whatever
+    // program() returned; a stand-in's shadow copies are shared, not duplicated
+    UniformTable& uniforms(unsigned int features);
+
+    // re-read the base sources when one of their files changed; the build
+    // queue already rebuilds the variants that exist, this is for later ones
+    void reload(const std::vector<std::string>& changedPaths);
+
+    // "NORMAL_MAP|SPECULAR", "base" for no features
+    std::string name(unsigned int features) const;
+    int featureCount() const { return (int)featureNames.size(); }
+    // variants submitted so far
+    int builtCount() const;
+
+private:
+    struct Variant {
+        // -1 until the variant was first asked for
+        ShaderBuildQueue::Handle handle;
+        UniformTable uniforms;
+    };
+
+    ShaderBuildQueue::Handle handle(unsigned int features);
+
+    ShaderBuildQueue& queue;
+    ProgramSource base;
+    std::vector<std::string> featureNames;
+    std::vector<Variant> variants;
+    unsigned int harmless;
+};
@@ -0,0 +1,110 @@
+#include "ShaderWatcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <climits>
+#else
+#include <filesystem>
+#endif
+
+using namespace std;
+
+namespace {
+#ifdef __linux__
+    string directoryOf(const string& path)
+    {
+        size_t slash = path.find_last_of("/\\");
+        return slash == string::npos ? "." : path.substr(0, slash);
+    }
+#else
+    uint64_t modifiedTime(const string& path)
+    {
+        error_code ec;
+        auto time = filesystem::last_write_time(path, ec);
+        return ec ? 0 : (uint64_t)time.time_since_epoch().count();
+    }
+#endif
+}
+
+ShaderWatcher::ShaderWatcher()
+{
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#else
+    lastCheck = chrono::steady_clock::now();
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+#endif
+}
+
+void ShaderWatcher::watch(const string& path)
+{
+    if (path.empty() || find(files.begin(), files.end(), path) != files.end())
+        return;
+    files.push_back(path);
+
+#ifdef __linux__
+    if (inotifyFd < 0)
+        return;
+    string directory = directoryOf(path);
+    for (const auto& entry : directories) {
+        if (entry.second == directory)
+            return;
+    }
+    int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd >= 0)
+        directories[wd] = directory;
+#else
+    stamps[path] = modifiedTime(path);
+#endif
+}
+
+vector<string> ShaderWatcher::poll()
+{
+    vector<string> changed;
+#ifdef __linux__
+    if (inotifyFd < 0)
+        return changed;
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        // EAGAIN: nothing left to read
+        if (length <= 0)
+            break;
+        for (char* ptr = buffer; ptr < buffer + length; ) {
+            const inotify_event* event = (const inotify_event*)ptr;
+            ptr += sizeof(inotify_event) + event->len;
+            auto directory = directories.find(event->wd);
+            if (event->len == 0 || directory == directories.end())
+                continue;
+            string path = directory->second + "/" + event->name;
+            if (find(files.begin(), files.end(), path) != files.end()
+                && find(changed.begin(), changed.end(), path) == changed.end())
+                changed.push_back(path);
+        }
+    }
+#else
+    // a stat per file every frame would add up, a few times a second is plenty
+    auto now = chrono::steady_clock::now();
+    if (now - lastCheck < chrono::milliseconds(250))
+        return changed;
+    lastCheck = now;
+    for (auto& entry : stamps) {
+        uint64_t stamp = modifiedTime(entry.first);
+        if (stamp != entry.second) {
+            entry.second = stamp;
+            changed.push_back(entry.first);
+        }
+    }
+#endif
+    return changed;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdint>
+
+// reports edits to a set of shader files without blocking
+// uses inotify on the containing directories on Linux (editors that save by
+// renaming a temp file show up as IN_MOVED_TO) and falls back to polling the
+// modification times a few times a second elsewhere
+class ShaderWatcher
+{
+public:
+    ShaderWatcher();
+    ~ShaderWatcher();
+
+    void watch(const std::string& path);
+    // watched files changed since the last call, each listed once
+    std::vector<std::string> poll();
+
+private:
+    std::vector<std::string> files;
+#ifdef __linux__
+    int inotifyFd;
+    // watch descriptor -> directory
+    std::map<int, std::string> directories;
+#else
+    std::map<std::string, uint64_t> stamps;
+    std::chrono::steady_clock::time_point lastCheck;
+#endif
+};
@@ -0,0 +1,135 @@
+#include "TextureFeedback.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+TextureFeedback::TextureFeedback(int windowWidth, int windowHeight, int scale, int interval)
+    : windowWidth(windowWidth), windowHeight(windowHeight), scale(scale), interval(interval), frame(0),
+    writeIndex(0), readIndex(0), inFlight(0)
+{
+    width = max(1, windowWidth / scale);
+    height = max(1, windowHeight / scale);
+
+    glGenTextures(1, &colorTex);
+    glBindTexture(GL_TEXTURE_2D, colorTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, width, height, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    glGenRenderbuffers(1, &depthRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTex, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(kReadbacks, pbos);
+    for (int i = 0; i < kReadbacks; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 2 * sizeof(GLuint), NULL, GL_STREAM_READ);
+        fences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool TextureFeedback::wantsPass() const
+{
+    // skip the pass while every pbo is still waiting on the GPU
+    return frame % interval == 0 && inFlight < kReadbacks;
+}
+
+float TextureFeedback::lodBias() const
+{
+    return log2((float)scale);
+}
+
+void TextureFeedback::begin()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+    // 0 means no texture was sampled here
+    const GLuint clearColor[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, clearColor);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void TextureFeedback::end()
+{
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[writeIndex]);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RG_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[writeIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    writeIndex = (writeIndex + 1) % kReadbacks;
+    inFlight++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void TextureFeedback::collect()
+{
+    frame++;
+    if (inFlight == 0)
+        return;
+
+    // never block: only look at the oldest readback once its fence has passed
+    GLenum status = glClientWaitSync(fences[readIndex], 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return;
+    glDeleteSync(fences[readIndex]);
+    fences[readIndex] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[readIndex]);
+    const GLuint* texels = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+        (GLsizeiptr)width * height * 2 * sizeof(GLuint), GL_MAP_READ_BIT);
+    if (texels) {
+        // the whole result replaces the previous one, so unseen textures drop out
+        fill(levels.begin(), levels.end(), -1);
+        for (int i = 0; i < width * height * 2; i++) {
+            GLuint value = texels[i];
+            if (value == 0)
+                continue;
+            int id = (int)(value >> 8) - 1;
+            int level = (int)(value & 0xFF);
+            // an untracked texture
+            if (id < 0)
+                continue;
+            if ((int)levels.size() <= id)
+                levels.resize(id + 1, -1);
+            if (levels[id] < 0 || level < levels[id])
+                levels[id] = level;
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readIndex = (readIndex + 1) % kReadbacks;
+    inFlight--;
+}
+
+int TextureFeedback::requiredLevel(int textureId) const
+{
+    if (textureId < 0 || textureId >= (int)levels.size())
+        return -1;
+    return levels[textureId];
+}
+
+void TextureFeedback::release()
+{
+    for (int i = 0; i < kReadbacks; i++) {
+        if (fences[i])
+            glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+    glDeleteBuffers(kReadbacks, pbos);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &depthRbo);
+    glDeleteTextures(1, &colorTex);
+}
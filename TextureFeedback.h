@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+
+// low resolution sampler feedback
+// a feedback pass renders the scene into a small RG32UI target where every
+// texel holds (texture id + 1) << 8 | mip level for the tex0 and norm_tex
+// samplers (id -1 for a texture nobody tracks); the target is read back through a ring of PBOs a few frames
+// later so the CPU never waits on the GPU
+class TextureFeedback
+{
+public:
+    // 1/scale of the window resolution, one pass every interval frames
+    TextureFeedback(int windowWidth, int windowHeight, int scale = 8, int interval = 4);
+
+    // true on the frames that should render the feedback pass
+    bool wantsPass() const;
+    // bind and clear the feedback target; restore with end()
+    void begin();
+    // queue the asynchronous readback and restore the default framebuffer
+    void end();
+    // consume a finished readback if there is one; call once per frame
+    void collect();
+
+    // finest mip level last seen for the texture id, -1 if it wasn't visible
+    int requiredLevel(int textureId) const;
+    // one past the highest texture id the last readback saw
+    int idCount() const { return (int)levels.size(); }
+    // subtracted from the LOD in the shader to account for the smaller target
+    float lodBias() const;
+
+    void release();
+
+private:
+    static const int kReadbacks = 3;
+
+    int width, height, windowWidth, windowHeight;
+    int scale, interval;
+    unsigned int frame;
+
+    GLuint fbo, colorTex, depthRbo;
+    GLuint pbos[kReadbacks];
+    GLsync fences[kReadbacks];
+    // next pbo to write, oldest pbo still in flight
+    int writeIndex, readIndex, inFlight;
+
+    std::vector<int> levels;
+};
@@ -0,0 +1,132 @@
+#include "TextureResidency.h"
+
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+
+TextureResidency::TextureResidency(TextureStreamer& streamer, size_t budgetBytes)
+    : streamer(streamer), frame(1)
+{
+    stats.residentBytes = 0;
+    stats.budgetBytes = budgetBytes;
+    stats.evictions = 0;
+    stats.reloads = 0;
+}
+
+void TextureResidency::trackStatic(GLuint id, size_t bytes)
+{
+    StaticTexture tex;
+    tex.id = id;
+    tex.bytes = bytes;
+    statics.push_back(tex);
+}
+
+void TextureResidency::touch(TextureStreamer::Handle handle, int wantedLevel)
+{
+    Entry& e = entry(handle);
+    // several users in one frame: the finest request wins
+    e.wantedLevel = e.lastUsed == frame ? min(e.wantedLevel, wantedLevel) : wantedLevel;
+    e.lastUsed = frame;
+}
+
+TextureResidency::Entry& TextureResidency::entry(TextureStreamer::Handle handle)
+{
+    while ((int)entries.size() <= handle) {
+        Entry e;
+        e.lastUsed = 0;
+        e.wantedLevel = 0;
+        e.evictedLevel = INT_MAX;
+        entries.push_back(e);
+    }
+    return entries[handle];
+}
+
+size_t TextureResidency::missingBytes(TextureStreamer::Handle handle, int level) const
+{
+    size_t bytes = 0;
+    for (int i = level; i < streamer.residentLevel(handle); i++)
+        bytes += streamer.levelBytes(handle, i);
+    return bytes;
+}
+
+size_t TextureResidency::totalBytes() const
+{
+    size_t bytes = 0;
+    for (const StaticTexture& tex : statics)
+        bytes += tex.bytes;
+    for (int handle = 0; handle < streamer.textureCount(); handle++)
+        bytes += streamer.residentBytes(handle);
+    return bytes;
+}
+
+void TextureResidency::update()
+{
+    int count = streamer.textureCount();
+    if (count > 0)
+        entry(count - 1);
+
+    // what memory will look like once the reads in flight have landed
+    size_t projected = totalBytes();
+    for (int handle = 0; handle < count; handle++)
+        projected += missingBytes(handle, streamer.requestedLevel(handle));
+
+    // stream in what was used this frame, as far as the budget allows
+    for (int handle = 0; handle < count; handle++) {
+        Entry& e = entries[handle];
+        if (e.lastUsed != frame || streamer.levelCount(handle) == 0)
+            continue;
+        int target = min(streamer.residentLevel(handle), streamer.requestedLevel(handle));
+        int level = target;
+        while (level > e.wantedLevel && projected + streamer.levelBytes(handle, level - 1) <= stats.budgetBytes) {
+            level--;
+            projected += streamer.levelBytes(handle, level);
+        }
+        if (level < target) {
+            stats.reloads += (unsigned int)max(0, target - max(level, e.evictedLevel));
+            streamer.requestLevel(handle, level);
+        }
+    }
+
+    // over budget: take the finest mip off the least recently used texture until it fits
+    while (projected > stats.budgetBytes) {
+        int victim = -1;
+        for (int handle = 0; handle < count; handle++) {
+            if (streamer.levelCount(handle) == 0)
+                continue;
+            int target = min(streamer.residentLevel(handle), streamer.requestedLevel(handle));
+            if (target >= streamer.tailLevel(handle))
+                continue;
+            if (victim < 0 || entries[handle].lastUsed < entries[victim].lastUsed)
+                victim = handle;
+        }
+        if (victim < 0)
+            break;
+
+        int resident = streamer.residentLevel(victim);
+        int requested = streamer.requestedLevel(victim);
+        if (requested < resident) {
+            // cancel the reads that haven't landed yet before dropping anything resident
+            projected -= missingBytes(victim, requested);
+            streamer.requestLevel(victim, resident);
+            continue;
+        }
+        projected -= streamer.levelBytes(victim, resident);
+        streamer.evictTo(victim, resident + 1);
+        entries[victim].evictedLevel = min(entries[victim].evictedLevel, resident);
+        stats.evictions++;
+    }
+
+    stats.residentBytes = totalBytes();
+    frame++;
+}
+
+void TextureResidency::release()
+{
+    for (StaticTexture& tex : statics) {
+        if (tex.id) {
+            glDeleteTextures(1, &tex.id);
+            tex.id = 0;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <glad/glad.h>
+
+#include "TextureStreamer.h"
+
+// keeps the estimated texture memory under a budget
+// streamed textures lose their finest mips least-recently-used first and
+// stream them back in when they get used again; static textures (the skybox)
+// only count against the budget and are deleted on release()
+class TextureResidency
+{
+public:
+    struct Stats {
+        size_t residentBytes;
+        size_t budgetBytes;
+        // mip levels dropped / streamed back after being dropped
+        unsigned int evictions;
+        unsigned int reloads;
+    };
+
+    TextureResidency(TextureStreamer& streamer, size_t budgetBytes);
+
+    // account for a texture the streamer doesn't own; it is deleted on release()
+    void trackStatic(GLuint id, size_t bytes);
+
+    // mark a streamed texture as used this frame and the finest level it needs
+    void touch(TextureStreamer::Handle handle, int wantedLevel = 0);
+
+    // evict and reload against the budget; call once per frame after the draws were recorded
+    void update();
+
+    void setBudget(size_t bytes) { stats.budgetBytes = bytes; }
+    const Stats& getStats() const { return stats; }
+
+    // delete the static textures; the streamed ones belong to the streamer
+    void release();
+
+private:
+    struct Entry {
+        unsigned int lastUsed;
+        int wantedLevel;
+        // finest level dropped by an eviction, levels below it count as reloads
+        int evictedLevel;
+    };
+
+    struct StaticTexture {
+        GLuint id;
+        size_t bytes;
+    };
+
+    Entry& entry(TextureStreamer::Handle handle);
+    size_t totalBytes() const;
+    // bytes the texture needs on top of what is resident to reach the level
+    size_t missingBytes(TextureStreamer::Handle handle, int level) const;
+
+    TextureStreamer& streamer;
+    std::vector<Entry> entries;
+    std::vector<StaticTexture> statics;
+    unsigned int frame;
+    Stats stats;
+};
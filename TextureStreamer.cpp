@@ -0,0 +1,486 @@
+#include "TextureStreamer.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+#include "stb_image.h"
+
+using namespace std;
+
+namespace {
+    // on-disk layout of <source>.mips: header followed by the levels, coarsest first
+    struct CookedHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        uint32_t flip;
+        uint64_t stamp;
+    };
+
+    const char kMagic[4] = { 'M', 'I', 'P', 'S' };
+    const uint32_t kVersion = 1;
+    const int kBytesPerTexel = 4;
+
+    // offset of a level inside the cooked file
+    size_t levelOffset(int width, int height, int levels, int level)
+    {
+        size_t offset = sizeof(CookedHeader);
+        for (int i = levels - 1; i > level; i--)
+            offset += MipCooker::levelSize(width, height, i);
+        return offset;
+    }
+
+    // 2x2 box filter, clamping at the edge for odd sizes
+    void downsample(const unsigned char* src, int sw, int sh, unsigned char* dst, int dw, int dh)
+    {
+        for (int y = 0; y < dh; y++) {
+            int y0 = min(y * 2, sh - 1);
+            int y1 = min(y * 2 + 1, sh - 1);
+            for (int x = 0; x < dw; x++) {
+                int x0 = min(x * 2, sw - 1);
+                int x1 = min(x * 2 + 1, sw - 1);
+                for (int c = 0; c < kBytesPerTexel; c++) {
+                    int sum = src[(y0 * sw + x0) * kBytesPerTexel + c]
+                        + src[(y0 * sw + x1) * kBytesPerTexel + c]
+                        + src[(y1 * sw + x0) * kBytesPerTexel + c]
+                        + src[(y1 * sw + x1) * kBytesPerTexel + c];
+                    dst[(y * dw + x) * kBytesPerTexel + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    // first level that fits inside the synchronously loaded tail
+    int firstTailLevel(int width, int height, int levels)
+    {
+        int level = 0;
+        while (level < levels - 1 && max(max(1, width >> level), max(1, height >> level)) > TextureStreamer::kTailSize)
+            level++;
+        return level;
+    }
+
+    // cooked file exists, matches the source and the flip setting
+    bool cookedIsCurrent(const string& source, const string& cooked, bool flip)
+    {
+        int w, h, levels;
+        bool cookedFlip;
+        uint64_t stamp;
+        if (!MipCooker::readHeader(cooked, w, h, levels, cookedFlip, stamp))
+            return false;
+        uint64_t sourceStamp = MipCooker::sourceStamp(source);
+        // a shipped cooked file without its source is still usable
+        return cookedFlip == flip && (sourceStamp == 0 || sourceStamp == stamp);
+    }
+}
+
+int MipCooker::levelCount(int width, int height)
+{
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
+    return levels;
+}
+
+size_t MipCooker::levelSize(int width, int height, int level)
+{
+    return (size_t)max(1, width >> level) * (size_t)max(1, height >> level) * kBytesPerTexel;
+}
+
+uint64_t MipCooker::sourceStamp(const string& source)
+{
+    error_code ec;
+    auto time = filesystem::last_write_time(source, ec);
+    if (ec)
+        return 0;
+    return (uint64_t)time.time_since_epoch().count();
+}
+
+bool MipCooker::readHeader(const string& cooked, int& width, int& height, int& levels, bool& flip, uint64_t& stamp)
+{
+    ifstream file(cooked, ios::binary);
+    if (!file)
+        return false;
+    CookedHeader header;
+    if (!file.read((char*)&header, sizeof(header)))
+        return false;
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+        return false;
+    width = (int)header.width;
+    height = (int)header.height;
+    levels = (int)header.levels;
+    flip = header.flip != 0;
+    stamp = header.stamp;
+    return levels == levelCount(width, height);
+}
+
+bool MipCooker::readLevels(const string& cooked, int level, int lastLevel, vector<unsigned char>& out)
+{
+    int w, h, levels;
+    bool flip;
+    uint64_t stamp;
+    if (!readHeader(cooked, w, h, levels, flip, stamp) || level < 0 || lastLevel >= levels || level > lastLevel)
+        return false;
+
+    size_t begin = levelOffset(w, h, levels, lastLevel);
+    size_t end = levelOffset(w, h, levels, level) + levelSize(w, h, level);
+    out.resize(end - begin);
+
+    ifstream file(cooked, ios::binary);
+    file.seekg((streamoff)begin);
+    return (bool)file.read((char*)out.data(), (streamsize)out.size());
+}
+
+bool MipCooker::cook(const string& source, const string& cooked, bool flip)
+{
+    int w, h, channels;
+    // the worker decodes with its own flip setting so the main thread's stays untouched
+    stbi_set_flip_vertically_on_load_thread(flip);
+    unsigned char* bytes = stbi_load(source.c_str(), &w, &h, &channels, kBytesPerTexel);
+    if (!bytes)
+        return false;
+
+    int levels = levelCount(w, h);
+    vector<vector<unsigned char>> chain(levels);
+    chain[0].assign(bytes, bytes + levelSize(w, h, 0));
+    stbi_image_free(bytes);
+    for (int i = 1; i < levels; i++) {
+        chain[i].resize(levelSize(w, h, i));
+        downsample(chain[i - 1].data(), max(1, w >> (i - 1)), max(1, h >> (i - 1)),
+            chain[i].data(), max(1, w >> i), max(1, h >> i));
+    }
+
+    CookedHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.width = (uint32_t)w;
+    header.height = (uint32_t)h;
+    header.levels = (uint32_t)levels;
+    header.flip = flip ? 1 : 0;
+    header.stamp = sourceStamp(source);
+
+    // write next to the final file and swap it in so readers never see half a file
+    string temp = cooked + ".tmp";
+    {
+        ofstream file(temp, ios::binary | ios::trunc);
+        if (!file)
+            return false;
+        file.write((const char*)&header, sizeof(header));
+        for (int i = levels - 1; i >= 0; i--)
+            file.write((const char*)chain[i].data(), (streamsize)chain[i].size());
+        if (!file)
+            return false;
+    }
+    error_code ec;
+    filesystem::rename(temp, cooked, ec);
+    return !ec;
+}
+
+TextureStreamer::TextureStreamer()
+    : uploadBudget(4 * 1024 * 1024), stopping(false)
+{
+    worker = thread(&TextureStreamer::workerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void TextureStreamer::release()
+{
+    for (StreamedTexture& tex : textures) {
+        if (tex.id) {
+            glDeleteTextures(1, &tex.id);
+            tex.id = 0;
+        }
+    }
+}
+
+TextureStreamer::Handle TextureStreamer::load(const string& path, bool flip, bool normalMap)
+{
+    StreamedTexture tex;
+    tex.path = path;
+    tex.cookedPath = path + ".mips";
+    tex.flip = flip;
+    tex.width = tex.height = tex.levels = 0;
+    tex.residentBase = 0;
+    tex.requestedBase = 0;
+    tex.pending = false;
+
+    glGenTextures(1, &tex.id);
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    Handle handle = (Handle)textures.size();
+
+    vector<unsigned char> tail;
+    int w, h, levels;
+    bool cookedFlip;
+    uint64_t stamp;
+    if (cookedIsCurrent(path, tex.cookedPath, flip)
+        && MipCooker::readHeader(tex.cookedPath, w, h, levels, cookedFlip, stamp)
+        && MipCooker::readLevels(tex.cookedPath, firstTailLevel(w, h, levels), levels - 1, tail)) {
+        // already cooked: the tail mips are a few KB, read them right away
+        tex.width = w;
+        tex.height = h;
+        tex.levels = levels;
+        tex.residentBase = levels;
+        uploadLevels(tex, firstTailLevel(w, h, levels), levels - 1, tail.data());
+        textures.push_back(tex);
+        return handle;
+    }
+
+    // flat grey / flat normal until the cook job comes back
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    const unsigned char flatNormal[4] = { 128, 128, 255, 255 };
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, normalMap ? flatNormal : grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+    tex.pending = true;
+    textures.push_back(tex);
+
+    Job job;
+    job.type = JOB_COOK;
+    job.handle = handle;
+    job.level = 0;
+    job.path = path;
+    job.cookedPath = tex.cookedPath;
+    job.flip = flip;
+    submit(job);
+    return handle;
+}
+
+void TextureStreamer::update()
+{
+    size_t uploaded = 0;
+    while (uploaded == 0 || uploaded < uploadBudget) {
+        Result result;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (results.empty())
+                break;
+            result = std::move(results.front());
+            results.pop_front();
+        }
+        uploaded += result.data.size() + 1;
+        applyResult(result);
+    }
+
+    // keep one read in flight per texture that is still short of its requested level
+    for (Handle handle = 0; handle < (Handle)textures.size(); handle++) {
+        StreamedTexture& tex = textures[handle];
+        if (tex.pending || tex.levels == 0 || tex.residentBase <= tex.requestedBase)
+            continue;
+        Job job;
+        job.type = JOB_READ_LEVEL;
+        job.handle = handle;
+        job.level = tex.residentBase - 1;
+        job.cookedPath = tex.cookedPath;
+        job.flip = tex.flip;
+        tex.pending = true;
+        submit(job);
+    }
+}
+
+void TextureStreamer::requestLevel(Handle handle, int level)
+{
+    StreamedTexture& tex = textures[handle];
+    tex.requestedBase = max(0, level);
+}
+
+int TextureStreamer::residentLevel(Handle handle) const
+{
+    return textures[handle].residentBase;
+}
+
+int TextureStreamer::requestedLevel(Handle handle) const
+{
+    return textures[handle].requestedBase;
+}
+
+int TextureStreamer::tailLevel(Handle handle) const
+{
+    const StreamedTexture& tex = textures[handle];
+    return firstTailLevel(tex.width, tex.height, tex.levels);
+}
+
+void TextureStreamer::evictTo(Handle handle, int level)
+{
+    StreamedTexture& tex = textures[handle];
+    if (tex.levels == 0 || !tex.id)
+        return;
+    level = min(level, tex.levels - 1);
+    tex.requestedBase = max(tex.requestedBase, level);
+    if (level <= tex.residentBase)
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+    // a zero sized image releases the storage of the dropped levels
+    for (int i = tex.residentBase; i < level; i++)
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    // a read still in flight for a finer level is dropped when it comes back
+    setBaseLevel(tex, level);
+}
+
+size_t TextureStreamer::residentBytes(Handle handle) const
+{
+    const StreamedTexture& tex = textures[handle];
+    size_t bytes = 0;
+    for (int i = tex.residentBase; i < tex.levels; i++)
+        bytes += MipCooker::levelSize(tex.width, tex.height, i);
+    return bytes;
+}
+
+GLuint TextureStreamer::texture(Handle handle) const
+{
+    return textures[handle].id;
+}
+
+int TextureStreamer::width(Handle handle) const
+{
+    return textures[handle].width;
+}
+
+int TextureStreamer::height(Handle handle) const
+{
+    return textures[handle].height;
+}
+
+int TextureStreamer::levelCount(Handle handle) const
+{
+    return textures[handle].levels;
+}
+
+size_t TextureStreamer::levelBytes(Handle handle, int level) const
+{
+    const StreamedTexture& tex = textures[handle];
+    if (tex.levels == 0 || level < 0 || level >= tex.levels)
+        return 0;
+    return MipCooker::levelSize(tex.width, tex.height, level);
+}
+
+bool TextureStreamer::idle() const
+{
+    for (const StreamedTexture& tex : textures) {
+        if (tex.pending || (tex.levels > 0 && tex.residentBase > tex.requestedBase))
+            return false;
+    }
+    return true;
+}
+
+void TextureStreamer::submit(const Job& job)
+{
+    {
+        lock_guard<mutex> lock(queueMutex);
+        jobs.push_back(job);
+    }
+    wake.notify_one();
+}
+
+void TextureStreamer::workerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        Result result;
+        runJob(job, result);
+
+        lock_guard<mutex> lock(queueMutex);
+        results.push_back(std::move(result));
+    }
+}
+
+void TextureStreamer::runJob(const Job& job, Result& result)
+{
+    result.type = job.type;
+    result.handle = job.handle;
+    result.ok = false;
+    result.width = result.height = result.levels = 0;
+    result.level = result.lastLevel = job.level;
+
+    if (job.type == JOB_COOK) {
+        if (!cookedIsCurrent(job.path, job.cookedPath, job.flip) && !MipCooker::cook(job.path, job.cookedPath, job.flip))
+            return;
+        bool flip;
+        uint64_t stamp;
+        if (!MipCooker::readHeader(job.cookedPath, result.width, result.height, result.levels, flip, stamp))
+            return;
+        result.level = firstTailLevel(result.width, result.height, result.levels);
+        result.lastLevel = result.levels - 1;
+    }
+    result.ok = MipCooker::readLevels(job.cookedPath, result.level, result.lastLevel, result.data);
+}
+
+void TextureStreamer::applyResult(Result& result)
+{
+    StreamedTexture& tex = textures[result.handle];
+    tex.pending = false;
+    if (!tex.id)
+        return;
+    if (!result.ok) {
+        cerr << "texture streaming failed for " << tex.path << endl;
+        // stop asking for levels that can't be read
+        tex.requestedBase = tex.residentBase;
+        return;
+    }
+
+    if (result.type == JOB_COOK) {
+        tex.width = result.width;
+        tex.height = result.height;
+        tex.levels = result.levels;
+        tex.residentBase = result.levels;
+        uploadLevels(tex, result.level, result.lastLevel, result.data.data());
+        return;
+    }
+
+    // a read the residency cancelled after it was submitted (requestLevel()
+    // raised the base past it) is dropped, uploading it would only go over
+    // the budget and get evicted again
+    if (result.level < tex.requestedBase)
+        return;
+    // only extend the resident chain by exactly one level
+    if (result.level == tex.residentBase - 1)
+        uploadLevels(tex, result.level, result.lastLevel, result.data.data());
+}
+
+void TextureStreamer::uploadLevels(StreamedTexture& tex, int level, int lastLevel, const unsigned char* data)
+{
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+    for (int i = lastLevel; i >= level; i--) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, max(1, tex.width >> i), max(1, tex.height >> i), 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, data);
+        data += MipCooker::levelSize(tex.width, tex.height, i);
+    }
+    setBaseLevel(tex, min(level, tex.residentBase));
+}
+
+void TextureStreamer::setBaseLevel(StreamedTexture& tex, int level)
+{
+    // sampling is clamped to the resident part of the chain
+    tex.residentBase = level;
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex.levels - 1);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <glad/glad.h>
+
+// streams 2D textures mip by mip out of a cooked file (<source>.mips)
+// the texture starts with its tiny tail mips (or a 1x1 placeholder when the
+// source has not been cooked yet) and the finer mips are read on a worker
+// thread, uploaded a few per frame and exposed through GL_TEXTURE_BASE_LEVEL
+class TextureStreamer
+{
+public:
+    typedef int Handle;
+
+    // largest mip that is read synchronously when a texture is loaded
+    static const int kTailSize = 16;
+
+    TextureStreamer();
+    ~TextureStreamer();
+    // delete the GL textures; call while the context is still alive
+    void release();
+
+    // register a texture; returns immediately with a usable GL texture
+    Handle load(const std::string& path, bool flip = true, bool normalMap = false);
+
+    // upload finished mip reads and queue the next ones; call once per frame
+    void update();
+
+    // finest mip level the texture should stream down to (0 = full resolution)
+    void requestLevel(Handle handle, int level);
+    int requestedLevel(Handle handle) const;
+    // finest mip level that is currently resident on the GPU
+    int residentLevel(Handle handle) const;
+    // coarsest level that is always kept resident (the synchronously loaded tail)
+    int tailLevel(Handle handle) const;
+    // drop every level finer than the given one and clamp the base level to it
+    void evictTo(Handle handle, int level);
+
+    GLuint texture(Handle handle) const;
+    int width(Handle handle) const;
+    int height(Handle handle) const;
+    // number of levels in the full chain, 0 while the header is still unknown
+    int levelCount(Handle handle) const;
+    // bytes of a single RGBA8 level / of every resident level
+    size_t levelBytes(Handle handle, int level) const;
+    size_t residentBytes(Handle handle) const;
+    int textureCount() const { return (int)textures.size(); }
+
+    // upper bound of bytes uploaded per update() call; at least one level always goes through
+    void setUploadBudget(size_t bytesPerFrame) { uploadBudget = bytesPerFrame; }
+    // true once every texture reached its requested level
+    bool idle() const;
+
+private:
+    struct StreamedTexture {
+        std::string path;
+        std::string cookedPath;
+        bool flip;
+        GLuint id;
+        int width, height, levels;
+        // finest resident level; == levels while only the placeholder is resident
+        int residentBase;
+        int requestedBase;
+        // a worker job for this texture is in flight
+        bool pending;
+    };
+
+    enum JobType { JOB_COOK, JOB_READ_LEVEL };
+
+    struct Job {
+        JobType type;
+        Handle handle;
+        int level;
+        std::string path;
+        std::string cookedPath;
+        bool flip;
+    };
+
+    struct Result {
+        JobType type;
+        Handle handle;
+        bool ok;
+        int width, height, levels;
+        // data holds lastLevel down to level in file order (coarsest first)
+        int level, lastLevel;
+        std::vector<unsigned char> data;
+    };
+
+    void workerLoop();
+    void runJob(const Job& job, Result& result);
+    void submit(const Job& job);
+    void applyResult(Result& result);
+    void uploadLevels(StreamedTexture& tex, int level, int lastLevel, const unsigned char* data);
+    void setBaseLevel(StreamedTexture& tex, int level);
+
+    std::vector<StreamedTexture> textures;
+    size_t uploadBudget;
+
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::deque<Result> results;
+    bool stopping;
+};
+
+// helpers for the cooked mip file
+namespace MipCooker {
+    // level dimensions of a width x height chain
+    int levelCount(int width, int height);
+    size_t levelSize(int width, int height, int level);
+    // make sure <source>.mips exists and is up to date; false if the source can't be read
+    bool cook(const std::string& source, const std::string& cooked, bool flip);
+    // read the header of a cooked file
+    bool readHeader(const std::string& cooked, int& width, int& height, int& levels, bool& flip, uint64_t& stamp);
+    // read level..lastLevel in file order (coarsest first)
+    bool readLevels(const std::string& cooked, int level, int lastLevel, std::vector<unsigned char>& out);
+    // last write time of the source file, 0 if it is missing
+    uint64_t sourceStamp(const std::string& source);
+}
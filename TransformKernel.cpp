@@ -0,0 +1,102 @@
+#include "TransformKernel.h"
+
+#include <xmmintrin.h>
+
+using namespace std;
+
+namespace {
+    // one object, same operations and order as the SSE path below
+    void composeOne(const TransformKernel::Arrays& in, size_t i, glm::mat4& world, glm::mat3& normal)
+    {
+        float x = in.rotationX[i], y = in.rotationY[i], z = in.rotationZ[i], w = in.rotationW[i];
+        float x2 = x + x, y2 = y + y, z2 = z + z;
+        float xx = x * x2, yy = y * y2, zz = z * z2;
+        float xy = x * y2, xz = x * z2, yz = y * z2;
+        float wx = w * x2, wy = w * y2, wz = w * z2;
+        // rotation[column][row], as glm::mat3_cast
+        float r[3][3] = {
+            { 1.f - (yy + zz), xy + wz, xz - wy },
+            { xy - wz, 1.f - (xx + zz), yz + wx },
+            { xz + wy, yz - wx, 1.f - (xx + yy) },
+        };
+        float s[3] = { in.scaleX[i], in.scaleY[i], in.scaleZ[i] };
+        float inverse[3] = { 1.f / s[0], 1.f / s[1], 1.f / s[2] };
+        for (int column = 0; column < 3; column++) {
+            for (int row = 0; row < 3; row++) {
+                world[column][row] = r[column][row] * s[row];
+                normal[column][row] = r[column][row] * inverse[row];
+            }
+            world[column][3] = 0.f;
+        }
+        world[3] = glm::vec4(in.positionX[i], in.positionY[i], in.positionZ[i], 1.f);
+    }
+
+    // lanes a, b, c, d are component x, y, z, w of the same column of four
+    // matrices; transposed, each register is that column of one matrix
+    void storeColumn(__m128 a, __m128 b, __m128 c, __m128 d, glm::mat4* worlds, int column)
+    {
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+        _mm_storeu_ps(&worlds[0][column][0], a);
+        _mm_storeu_ps(&worlds[1][column][0], b);
+        _mm_storeu_ps(&worlds[2][column][0], c);
+        _mm_storeu_ps(&worlds[3][column][0], d);
+    }
+}
+
+void TransformKernel::compose(const Arrays& in, size_t begin, size_t end, glm::mat4* worlds, glm::mat3* normals)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 zero = _mm_setzero_ps();
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(in.rotationX + i);
+        __m128 y = _mm_loadu_ps(in.rotationY + i);
+        __m128 z = _mm_loadu_ps(in.rotationZ + i);
+        __m128 w = _mm_loadu_ps(in.rotationW + i);
+        __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+        // rotation, r<column><row>
+        __m128 r00 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+        __m128 r01 = _mm_add_ps(xy, wz);
+        __m128 r02 = _mm_sub_ps(xz, wy);
+        __m128 r10 = _mm_sub_ps(xy, wz);
+        __m128 r11 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+        __m128 r12 = _mm_add_ps(yz, wx);
+        __m128 r20 = _mm_add_ps(xz, wy);
+        __m128 r21 = _mm_sub_ps(yz, wx);
+        __m128 r22 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+        // the scale goes on the rows: scale * rotate
+        __m128 sx = _mm_loadu_ps(in.scaleX + i);
+        __m128 sy = _mm_loadu_ps(in.scaleY + i);
+        __m128 sz = _mm_loadu_ps(in.scaleZ + i);
+        storeColumn(_mm_mul_ps(r00, sx), _mm_mul_ps(r01, sy), _mm_mul_ps(r02, sz), zero, worlds + i, 0);
+        storeColumn(_mm_mul_ps(r10, sx), _mm_mul_ps(r11, sy), _mm_mul_ps(r12, sz), zero, worlds + i, 1);
+        storeColumn(_mm_mul_ps(r20, sx), _mm_mul_ps(r21, sy), _mm_mul_ps(r22, sz), zero, worlds + i, 2);
+        storeColumn(_mm_loadu_ps(in.positionX + i), _mm_loadu_ps(in.positionY + i), _mm_loadu_ps(in.positionZ + i), one, worlds + i, 3);
+
+        // inverse transpose of scale * rotate = scale^-1 * rotate; a mat3
+        // is 9 floats, so the lanes go out through a small buffer
+        __m128 ix = _mm_div_ps(one, sx), iy = _mm_div_ps(one, sy), iz = _mm_div_ps(one, sz);
+        alignas(16) float lanes[9][4];
+        _mm_store_ps(lanes[0], _mm_mul_ps(r00, ix));
+        _mm_store_ps(lanes[1], _mm_mul_ps(r01, iy));
+        _mm_store_ps(lanes[2], _mm_mul_ps(r02, iz));
+        _mm_store_ps(lanes[3], _mm_mul_ps(r10, ix));
+        _mm_store_ps(lanes[4], _mm_mul_ps(r11, iy));
+        _mm_store_ps(lanes[5], _mm_mul_ps(r12, iz));
+        _mm_store_ps(lanes[6], _mm_mul_ps(r20, ix));
+        _mm_store_ps(lanes[7], _mm_mul_ps(r21, iy));
+        _mm_store_ps(lanes[8], _mm_mul_ps(r22, iz));
+        for (int lane = 0; lane < 4; lane++) {
+            float* normal = &normals[i + lane][0][0];
+            for (int element = 0; element < 9; element++)
+                normal[element] = lanes[element][lane];
+        }
+    }
+    for (; i < end; i++)
+        composeOne(in, i, worlds[i], normals[i]);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// world / normal matrices of many objects at once from split component
+// arrays (x of every object, then y, ...), four objects per SSE step
+namespace TransformKernel {
+    // inputs, one float per object in each array; rotation is a unit quaternion
+    struct Arrays {
+        const float* positionX;
+        const float* positionY;
+        const float* positionZ;
+        const float* rotationX;
+        const float* rotationY;
+        const float* rotationZ;
+        const float* rotationW;
+        const float* scaleX;
+        const float* scaleY;
+        const float* scaleZ;
+    };
+
+    // world = translate * scale * rotate and its inverse transpose (the
+    // normal matrix) for objects [begin, end); the tail that doesn't fill an
+    // SSE group is done one object at a time with the same arithmetic
+    void compose(const Arrays& in, size_t begin, size_t end, glm::mat4* worlds, glm::mat3* normals);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstring>
+#include <glad/glad.h>
+
+// uniform buffer holding one std140 block; T is the block's struct from the
+// generated ShaderInterface.h, so filling it in is plain member assignment and
+// the upload is a single copy of the whole struct
+template<typename T>
+class UniformBlock
+{
+public:
+    explicit UniformBlock(GLuint binding)
+        : data(), uploaded(), hasUploaded(false), skipped(0), bindingPoint(binding)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // stays bound, nothing else uses this binding point
+        glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer);
+    }
+
+    // copy data into the buffer unless it is byte for byte what was last uploaded
+    void upload()
+    {
+        // value-initialized, so the padding members compare equal too
+        if (hasUploaded && memcmp(&data, &uploaded, sizeof(T)) == 0) {
+            skipped++;
+            return;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploaded = data;
+        hasUploaded = true;
+    }
+
+    GLuint binding() const { return bindingPoint; }
+    // uploads skipped because the block was unchanged
+    unsigned int skippedUploads() const { return skipped; }
+
+    void release()
+    {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+    T data;
+
+private:
+    T uploaded;
+    bool hasUploaded;
+    unsigned int skipped;
+    GLuint bindingPoint;
+    GLuint buffer;
+};
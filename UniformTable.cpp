@@ -0,0 +1,202 @@
+#include "UniformTable.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace std;
+
+UniformTable::Stats UniformTable::thisFrame = { 0, 0, 0 };
+UniformTable::Stats UniformTable::lastFrame = { 0, 0, 0 };
+unordered_map<GLuint, shared_ptr<UniformTable::Program>> UniformTable::programs;
+
+namespace {
+    // bytes of one element of a uniform type, 0 for types the table doesn't shadow
+    size_t typeBytes(GLenum type)
+    {
+        switch (type) {
+        case GL_FLOAT: return sizeof(float);
+        case GL_FLOAT_VEC2: return 2 * sizeof(float);
+        case GL_FLOAT_VEC3: return 3 * sizeof(float);
+        case GL_FLOAT_VEC4: return 4 * sizeof(float);
+        case GL_FLOAT_MAT3: return 9 * sizeof(float);
+        case GL_FLOAT_MAT4: return 16 * sizeof(float);
+        case GL_INT: return sizeof(GLint);
+        case GL_UNSIGNED_INT: return sizeof(GLuint);
+        case GL_BOOL: return sizeof(GLint);
+        // samplers are set as ints
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_INT_SAMPLER_2D:
+            return sizeof(GLint);
+        default: return 0;
+        }
+    }
+
+    bool isSampler(GLenum type)
+    {
+        return type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY
+            || type == GL_UNSIGNED_INT_SAMPLER_2D || type == GL_INT_SAMPLER_2D;
+    }
+}
+
+UniformTable::UniformTable()
+    : current(0)
+{
+}
+
+void UniformTable::bind(GLuint program)
+{
+    if (program == current && !(state && state->deleted))
+        return;
+    current = program;
+    // another table already reflected it
+    auto it = programs.find(program);
+    if (it != programs.end()) {
+        state = it->second;
+        return;
+    }
+    state = make_shared<Program>();
+    state->deleted = false;
+    programs[program] = state;
+    vector<Uniform>& uniforms = state->uniforms;
+    vector<unsigned char>& values = state->values;
+
+    GLint count = 0, maxName = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxName);
+    vector<GLchar> name(max(maxName, 1));
+
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        Uniform uniform;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, name.data());
+        string uniformName(name.data(), length);
+        uniform.location = glGetUniformLocation(program, uniformName.c_str());
+        // block members have no location, they are fed through their buffer
+        if (uniform.location < 0)
+            continue;
+        // arrays are reported as name[0]
+        size_t bracket = uniformName.find('[');
+        if (bracket != string::npos)
+            uniformName = uniformName.substr(0, bracket);
+
+        uniform.bytes = typeBytes(uniform.type) * uniform.size;
+        uniform.offset = values.size();
+        uniform.uploaded = false;
+        values.resize(values.size() + uniform.bytes);
+        state->indices[uniformName] = (int)uniforms.size();
+        uniforms.push_back(uniform);
+    }
+}
+
+void UniformTable::forget(GLuint program)
+{
+    auto it = programs.find(program);
+    if (it == programs.end())
+        return;
+    it->second->deleted = true;
+    programs.erase(it);
+}
+
+int UniformTable::find(const string& name) const
+{
+    if (!state)
+        return -1;
+    auto it = state->indices.find(name);
+    return it == state->indices.end() ? -1 : it->second;
+}
+
+bool UniformTable::changed(const string& name, GLenum type, const void* data, size_t bytes, GLint& location)
+{
+    int index = find(name);
+    // inactive uniform: glUniform* on location -1 would be a no-op as well
+    if (index < 0)
+        return false;
+    thisFrame.lookupsSaved++;
+
+    Uniform& uniform = state->uniforms[index];
+    bool typeMatches = uniform.type == type || (type == GL_INT && (isSampler(uniform.type) || uniform.type == GL_BOOL));
+    if (!typeMatches || bytes > uniform.bytes) {
+        cerr << "uniform " << name << " set with the wrong type" << endl;
+        return false;
+    }
+
+    location = uniform.location;
+    unsigned char* shadow = &state->values[uniform.offset];
+    if (uniform.uploaded && memcmp(shadow, data, bytes) == 0) {
+        thisFrame.skipped++;
+        return false;
+    }
+    memcpy(shadow, data, bytes);
+    uniform.uploaded = true;
+    thisFrame.uploads++;
+    return true;
+}
+
+void UniformTable::set(const string& name, int value)
+{
+    GLint location;
+    if (changed(name, GL_INT, &value, sizeof(value), location))
+        glUniform1i(location, value);
+}
+
+void UniformTable::set(const string& name, unsigned int value)
+{
+    GLint location;
+    if (changed(name, GL_UNSIGNED_INT, &value, sizeof(value), location))
+        glUniform1ui(location, value);
+}
+
+void UniformTable::set(const string& name, float value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT, &value, sizeof(value), location))
+        glUniform1f(location, value);
+}
+
+void UniformTable::set(const string& name, const glm::vec2& value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT_VEC2, glm::value_ptr(value), sizeof(float) * 2, location))
+        glUniform2fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformTable::set(const string& name, const glm::vec3& value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT_VEC3, glm::value_ptr(value), sizeof(float) * 3, location))
+        glUniform3fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformTable::set(const string& name, const glm::vec4& value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT_VEC4, glm::value_ptr(value), sizeof(float) * 4, location))
+        glUniform4fv(location, 1, glm::value_ptr(value));
+}
+
+void UniformTable::set(const string& name, const glm::mat3& value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT_MAT3, glm::value_ptr(value), sizeof(float) * 9, location))
+        glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void UniformTable::set(const string& name, const glm::mat4& value)
+{
+    GLint location;
+    if (changed(name, GL_FLOAT_MAT4, glm::value_ptr(value), sizeof(float) * 16, location))
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void UniformTable::endFrame()
+{
+    lastFrame = thisFrame;
+    thisFrame.uploads = 0;
+    thisFrame.skipped = 0;
+    thisFrame.lookupsSaved = 0;
+}
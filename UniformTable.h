@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// active uniforms of one program, reflected once after it links
+// set() keeps a shadow copy of the last uploaded value and skips the GL call
+// when nothing changed; the program has to be current (glUseProgram) when a
+// value is set, like with plain glUniform*. the shadows belong to the GL
+// program, not the table: tables bound to the same program (a variant
+// standing in for another, the fallback) share them
+class UniformTable
+{
+public:
+    struct Stats {
+        // glUniform* calls issued / skipped because the value was unchanged
+        unsigned int uploads;
+        unsigned int skipped;
+        // glGetUniformLocation calls replaced by the reflected table
+        unsigned int lookupsSaved;
+    };
+
+    UniformTable();
+
+    // reflect the program if it isn't the one the table was built for
+    // (first link, fallback -> real program, hot reload swap)
+    void bind(GLuint program);
+    GLuint program() const { return current; }
+
+    // the program is about to be deleted, its name may come back as another one
+    static void forget(GLuint program);
+
+    // index of an active uniform, -1 if the program doesn't use it
+    int find(const std::string& name) const;
+    bool has(const std::string& name) const { return find(name) >= 0; }
+
+    void set(const std::string& name, int value);
+    void set(const std::string& name, unsigned int value);
+    void set(const std::string& name, float value);
+    void set(const std::string& name, const glm::vec2& value);
+    void set(const std::string& name, const glm::vec3& value);
+    void set(const std::string& name, const glm::vec4& value);
+    void set(const std::string& name, const glm::mat3& value);
+    void set(const std::string& name, const glm::mat4& value);
+
+    // counters of the last finished frame; endFrame() rolls them over
+    static const Stats& frameStats() { return lastFrame; }
+    static void endFrame();
+
+private:
+    struct Uniform {
+        GLint location;
+        GLenum type;
+        GLint size;
+        // offset of the shadow copy in values
+        size_t offset;
+        size_t bytes;
+        bool uploaded;
+    };
+
+    // reflection and shadow copies of one GL program
+    struct Program {
+        std::vector<Uniform> uniforms;
+        std::unordered_map<std::string, int> indices;
+        std::vector<unsigned char> values;
+        // set by forget(), tables still holding it reflect again on bind()
+        bool deleted;
+    };
+
+    // true if the value differs from the shadow copy, which is then updated
+    bool changed(const std::string& name, GLenum type, const void* data, size_t bytes, GLint& location);
+
+    GLuint current;
+    std::shared_ptr<Program> state;
+
+    static std::unordered_map<GLuint, std::shared_ptr<Program>> programs;
+    static Stats thisFrame;
+    static Stats lastFrame;
+};
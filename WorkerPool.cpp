@@ -0,0 +1,84 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(int workerCount)
+    : job(nullptr), count(0), chunk(0), next(0), generation(0), busy(0), stopping(false)
+{
+    if (workerCount < 0)
+        workerCount = max(1, (int)thread::hardware_concurrency()) - 1;
+    for (int i = 0; i < workerCount; i++)
+        workers.push_back(thread(&WorkerPool::workerLoop, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (thread& worker : workers)
+        worker.join();
+}
+
+void WorkerPool::parallelFor(size_t itemCount, size_t grain, const RangeFunc& rangeJob)
+{
+    if (itemCount == 0)
+        return;
+    grain = max<size_t>(grain, 1);
+    if (workers.empty() || itemCount <= grain) {
+        rangeJob(0, itemCount);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+        job = &rangeJob;
+        count = itemCount;
+        // a few chunks per thread so an uneven split evens out
+        chunk = max(grain, itemCount / (threadCount() * 4));
+        chunk = (chunk + 3) & ~(size_t)3;
+        next = 0;
+        busy = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    runChunks();
+
+    unique_lock<mutex> lock(poolMutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::runChunks()
+{
+    while (true) {
+        size_t begin = next.fetch_add(chunk);
+        if (begin >= count)
+            return;
+        (*job)(begin, min(begin + chunk, count));
+    }
+}
+
+void WorkerPool::workerLoop()
+{
+    unsigned int seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(poolMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        runChunks();
+
+        lock_guard<mutex> lock(poolMutex);
+        if (--busy == 0)
+            finished.notify_one();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// fixed set of threads for data-parallel loops over dense arrays
+// parallelFor() hands out chunks of the range to the workers and the calling
+// thread alike and returns once all of them are done, so the caller owns
+// the data again right after the call
+class WorkerPool
+{
+public:
+    // one chunk, [begin, end)
+    typedef std::function<void(size_t begin, size_t end)> RangeFunc;
+
+    // workers next to the calling thread; -1 = one per core but the caller's
+    explicit WorkerPool(int workers = -1);
+    ~WorkerPool();
+
+    // run job over [0, count) in chunks of at least grain items (rounded up
+    // to a multiple of 4 so SIMD groups don't straddle chunks); small ranges
+    // run on the calling thread only
+    void parallelFor(size_t count, size_t grain, const RangeFunc& job);
+
+    // threads that take part in parallelFor, the caller included
+    int threadCount() const { return (int)workers.size() + 1; }
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> workers;
+    std::mutex poolMutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    // the loop being run; generation tells the workers a new one started
+    const RangeFunc* job;
+    size_t count;
+    size_t chunk;
+    std::atomic<size_t> next;
+    unsigned int generation;
+    // workers still inside the current loop
+    int busy;
+    bool stopping;
+};
@@ -0,0 +1,9 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// only whether a sample passes the depth test matters, color writes are masked off
+void main()
+{
+	FragColor = vec4(1.0);
+}
\ No newline at end of file
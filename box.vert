@@ -0,0 +1,29 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+
+// per-frame data shared by every program, binding point 0
+struct Light {
+	vec4 position;
+	vec4 color;
+};
+
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 cameraPos;
+	Light lights[4];
+	// rgb = ambient color, a = ambient strength
+	vec4 ambient;
+	int lightCount;
+};
+
+// world space box the unit cube (corners at -1 / 1) is stretched over
+uniform vec3 boxCenter;
+uniform vec3 boxExtent;
+
+void main()
+{
+	gl_Position = viewProj * vec4(boxCenter + aPos * boxExtent, 1.0);
+}
\ No newline at end of file
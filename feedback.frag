@@ -0,0 +1,35 @@
+#version 330 core
+
+uniform sampler2D tex0;
+
+// streamer handles of the textures bound to tex0 / norm_tex
+uniform uint tex0Id;
+uniform uint normTexId;
+// full resolution of those textures
+uniform vec2 tex0Size;
+uniform vec2 normTexSize;
+// log2 of how much smaller the feedback target is than the window
+uniform float lodBias;
+
+in vec2 texCoord;
+
+out uvec2 FragFeedback;
+
+uint feedbackTexel(uint id, vec2 size)
+{
+	vec2 dx = dFdx(texCoord * size);
+	vec2 dy = dFdy(texCoord * size);
+	float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) - lodBias;
+	uint level = uint(clamp(floor(lod), 0.0, 255.0));
+	return ((id + 1u) << 8) | level;
+}
+
+void main()
+{
+	// same cutout as sample.frag so hidden texels don't request mips
+	if(texture(tex0, texCoord).a < 0.1) {
+		discard;
+	}
+
+	FragFeedback = uvec2(feedbackTexel(tex0Id, tex0Size), feedbackTexel(normTexId, normTexSize));
+}
@@ -1,5 +1,8 @@
 #include <string>
 #include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -11,22 +14,48 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-// modifier for the model's x position
-float x_mod = 0;
-// modifier for the model's y position
-float y_mod = 0;
-// modifier for the model's z position
-float z_mod = -2.f;
-// modifier for the model's theta
-float theta_mod = 0;
-// modifier for the model's x axis
-float axis_x_mod = 1;
-// modifier for the model's y axis
-float axis_y_mod = 0;
-// modifier for the model's x scale
-float scale_x_mod = 1;
-// modifier for the model's y scale
-float scale_y_mod = 1;
+#include "TextureStreamer.h"
+#include "TextureResidency.h"
+#include "TextureFeedback.h"
+#include "ProgramCache.h"
+#include "ShaderBuildQueue.h"
+#include "ShaderWatcher.h"
+#include "ShaderFiles.h"
+#include "UniformTable.h"
+#include "GLState.h"
+#include "RenderQueue.h"
+#include "GpuCuller.h"
+#include "GeometryPool.h"
+#include "Scene.h"
+#include "WorkerPool.h"
+#include "FrustumCuller.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "FrameUniforms.h"
+#include "UniformBlock.h"
+#include "ShaderInterface.h"
+#include "Material.h"
+#include "ShaderVariants.h"
+#include "BenchCases.h"
+
+// objects of the frame
+Scene scene;
+// the object the keys move, rotate and scale; set once the scene is built
+Entity controlled = { 0, ~0u };
+// print the profiling counters on the next frame
+bool print_stats = false;
+
+// nudge the controlled object's position
+void moveControlled(const glm::vec3& delta)
+{
+    scene.setPosition(controlled, scene.position(controlled) + delta);
+}
+
+// grow / shrink the controlled object in x and y
+void scaleControlled(float delta)
+{
+    scene.setScale(controlled, scene.scale(controlled) + glm::vec3(delta, delta, 0.f));
+}
 
 void Key_CallBack(GLFWwindow* window, // pointer to the window
     int key, // keycode of the press
@@ -34,71 +63,86 @@ void Key_CallBack(GLFWwindow* window, // pointer to the window
     int action, // either press / release
     int mods) // which modifier keys is held down
 {
+    // when user presses P
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {   // dump profiling counters
+        print_stats = true;
+    }
+    // the rest act on the controlled object
+    if (!scene.alive(controlled))
+        return;
     // when user presses D
     if (key == GLFW_KEY_D) {  // move to right
-        x_mod += 0.1f;
+        moveControlled(glm::vec3(0.1f, 0, 0));
     }
     // when user presses A
     if (key == GLFW_KEY_A) {  // move to left
-        x_mod -= 0.1f;
+        moveControlled(glm::vec3(-0.1f, 0, 0));
     }
     // when user presses S
     if (key == GLFW_KEY_S) {  // move down
-        y_mod -= 0.1f;
+        moveControlled(glm::vec3(0, -0.1f, 0));
     }
     // when user presses W
     if (key == GLFW_KEY_W) {  // move up
-        y_mod += 0.1f;
+        moveControlled(glm::vec3(0, 0.1f, 0));
     }
     // when user presses up
     if (key == GLFW_KEY_UP) {   // rotate up
-        theta_mod -= 10;
-        axis_x_mod = 1;
-        axis_y_mod = 0;
+        scene.rotate(controlled, -10, glm::vec3(1, 0, 0));
     }
     // when user presses down
     if (key == GLFW_KEY_DOWN) { // rotate bunny down
-        theta_mod += 10;
-        axis_x_mod = 1;
-        axis_y_mod = 0;
+        scene.rotate(controlled, 10, glm::vec3(1, 0, 0));
     }
     // when user presses left
     if (key == GLFW_KEY_LEFT) { // rotate bunny left
-        theta_mod -= 10;
-        axis_y_mod = 1;
-        axis_x_mod = 0;
+        scene.rotate(controlled, -10, glm::vec3(0, 1, 0));
     }
     // when user presses right
     if (key == GLFW_KEY_RIGHT) {    // rotate bunny right
-        theta_mod += 10;
-        axis_y_mod = 1;
-        axis_x_mod = 0;
+        scene.rotate(controlled, 10, glm::vec3(0, 1, 0));
     }
     // when user presses Q
     if (key == GLFW_KEY_Q) {    // decrease
-        scale_x_mod -= 0.1f;
-        scale_y_mod -= 0.1f;
+        scaleControlled(-0.1f);
     }
     // when user presses E
     if (key == GLFW_KEY_E) {    // increase
-        scale_x_mod += 0.1f;
-        scale_y_mod += 0.1f;
+        scaleControlled(0.1f);
     }
     // when user presses Z
     if (key == GLFW_KEY_Z) {    // zoom in
-        z_mod -= -0.1f;
+        moveControlled(glm::vec3(0, 0, 0.1f));
     }
     // when user presses X
     if (key == GLFW_KEY_X) {    // zoom out
-        z_mod += -0.1f;
+        moveControlled(glm::vec3(0, 0, -0.1f));
     }
 }
 
 using namespace std;
+// generated from the shaders by ShaderGen before every build
+using namespace ShaderInterface;
 
-int main(void)
+int main(int argc, char** argv)
 {
-    float x = 0, y = 3, z = 0, scale_x = 3, scale_y = 3, scale_z = 3, theta = 1, axis_x = 1, axis_y = 0, axis_z = 0;
+    // --bench runs the benchmark cases instead of the interactive scene and exits
+    // --bench-frames N measures N frames per case (after N / 4 warmup frames)
+    // --shader-dir DIR reads the shaders from DIR and hot reloads them instead
+    // of using the copies built into the executable
+    bool benchMode = false;
+    int benchFrames = 240;
+    string shaderDir;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--bench")
+            benchMode = true;
+        else if (arg == "--bench-frames" && i + 1 < argc)
+            benchFrames = max(1, atoi(argv[++i]));
+        else if (arg == "--shader-dir" && i + 1 < argc)
+            shaderDir = argv[++i];
+    }
+
     float window_width = 600.f;
     float window_height = 600.f;
     glm::mat4 identity_matrix = glm::mat4(1.0f);
@@ -118,133 +162,118 @@ int main(void)
     /* Make the window's context current */
     glfwMakeContextCurrent(window);
     gladLoadGL();
+    // vsync would cap every benchmark case at the refresh rate
+    if (benchMode)
+        glfwSwapInterval(0);
 
     glViewport(0, 0, window_width, window_height);
 
-    int img_width, img_height, colorChannels;
-    stbi_set_flip_vertically_on_load(true);
-    // load the texture and fill out the variables
-    unsigned char* tex_bytes = stbi_load("3D/brickwall.jpg", &img_width, &img_height, &colorChannels, 0);
+    // streams textures from their cooked mip files on a worker thread
+    TextureStreamer streamer;
+    // keeps the estimated texture memory under this many bytes
+    TextureResidency residency(streamer, 64 * 1024 * 1024);
+    // only the tiny tail mips are loaded here, the rest streams in over the next frames
+    TextureStreamer::Handle brickTex = streamer.load("3D/brickwall.jpg");
     // OpenGL reference to the texture
-    GLuint texture;
-    // generate a reference
-    glGenTextures(1, &texture);
-    // set the current texture we're working with on to Texture 0
-    glActiveTexture(GL_TEXTURE0);
-    // bind out next tasks to tex0 to our current refernce similar to what wer're doing to VBOs
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // assign the loaded texture to the OpenGL reference
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img_width, img_height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex_bytes);
-    // generate the mipmaps to the current texture
-    glGenerateMipmap(GL_TEXTURE_2D);
-    // free up the loaded bytes
-    stbi_image_free(tex_bytes);
+    GLuint texture = streamer.texture(brickTex);
     // enable depth testing
     glEnable(GL_DEPTH_TEST);
 
-    int img_width2, img_height2, colorChannels2;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* normal_bytes = stbi_load("3D/brickwall_normal.jpg", &img_width2, &img_height2, &colorChannels2, 0);
-    GLuint norm_tex;
-    glGenTextures(1, &norm_tex);
+    TextureStreamer::Handle brickNormTex = streamer.load("3D/brickwall_normal.jpg", true, true);
+    GLuint norm_tex = streamer.texture(brickNormTex);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, norm_tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexImage2D(GL_TEXTURE_2D, 1, GL_RGB, img_width2, img_height2, 0, GL_RGB, GL_UNSIGNED_BYTE, normal_bytes);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(normal_bytes);
-    glEnable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0);
 
     // set the callback function to the window
     glfwSetKeyCallback(window, Key_CallBack);
 
-    // load the shader file into a string stream        vertex
-    fstream vertSrc("Shaders/sample.vert");
-    stringstream vertBuff;
-    // add the file stream to the string stream
-    vertBuff << vertSrc.rdbuf();
-    // convert the stream to a character array
-    string vertS = vertBuff.str();
-    const char* v = vertS.c_str();
-
-    // load the shader file into a string stream        fragment
-    fstream fragSrc("Shaders/sample.frag");
-    stringstream fragBuff;
-    // add the file stream to the string stream
-    fragBuff << fragSrc.rdbuf();
-    // convert the stream to a character array
-    string fragS = fragBuff.str();
-    const char* f = fragS.c_str();
-
-    // create a vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    // assign the source to the vertex shader
-    glShaderSource(vertexShader, 1, &v, NULL);
-    // compile the vertex shader
-    glCompileShader(vertexShader);
-
-    // create a fragment shader
-    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    // assign the source to the fragment shader
-    glShaderSource(fragShader, 1, &f, NULL);
-    // compile the fragment shader
-    glCompileShader(fragShader);
-
-    fstream skyboxVertSrc("Shaders/skybox.vert");
-    stringstream skyboxVertBuff;
-    skyboxVertBuff << skyboxVertSrc.rdbuf();
-    string skyboxVertS = skyboxVertBuff.str();
-    const char* sky_v = skyboxVertS.c_str();
-
-    fstream skyboxFragSrc("Shaders/skybox.frag");
-    stringstream skyboxFragBuff;
-    skyboxFragBuff << skyboxFragSrc.rdbuf();
-    string skyboxFragS = skyboxFragBuff.str();
-    const char* sky_f = skyboxFragS.c_str();
-
-    GLuint vertexShaderSkybox = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShaderSkybox, 1, &sky_v, NULL);
-    glCompileShader(vertexShaderSkybox);
-
-    GLuint fragShaderSkybox = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragShaderSkybox, 1, &sky_f, NULL);
-    glCompileShader(fragShaderSkybox);
-
-    GLint isCompiled = 0;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &isCompiled);
-    if (isCompiled == GL_FALSE)
-    {
-        GLint maxLength = 0;
-        glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &maxLength);
-
-        // The maxLength includes the NULL character
-        vector<GLchar> errorLog(maxLength);
-        // cout << errorLog[maxLength];
-        glGetShaderInfoLog(vertexShader, maxLength, &maxLength, &errorLog[0]);
-
-        // Provide the infolog in whatever manor you deem best.
-        // Exit with failure.
-        glDeleteShader(vertexShader); // Don't leak the shader.
+    // linked programs are cached on disk, keyed by sources, defines and driver
+    ProgramCache programCache("ShaderCache");
+    // every program is submitted up front and compiles while the first frames render
+    ShaderBuildQueue buildQueue(programCache);
+    // camera and lights live in one uniform buffer every program reads from
+    FrameUniforms frameUniforms;
+    // transform and material of the object being drawn
+    UniformBlock<ObjectData> objectUniforms(Binding::ObjectData);
+    for (const BlockBinding& block : kBlockBindings)
+        buildQueue.bindBlock(block.name, block.binding);
+
+    // embedded at build time unless --shader-dir points somewhere else
+    ShaderFiles shaderFiles(shaderDir);
+
+    ProgramSource sampleSource;
+    sampleSource.name = "sample";
+    sampleSource.vertexPath = shaderFiles.path("sample.vert");
+    sampleSource.fragmentPath = shaderFiles.path("sample.frag");
+    sampleSource.vertex = shaderFiles.read(sampleSource.vertexPath);
+    sampleSource.fragment = shaderFiles.read(sampleSource.fragmentPath);
+    // the vertex stage only carries light vectors for the lights the scene uses
+    sampleSource.defines = "#define LIGHT_COUNT 1\n";
+    // specialized per feature set; a variant compiles the first time a material needs it
+    ShaderVariants sampleVariants(buildQueue, sampleSource, kSampleFeatureNames, kSampleFeatureCount);
+    // with neutral inputs (opaque albedo, no specular strength) these don't change the result
+    sampleVariants.setHarmlessFeatures(FEATURE_ALPHA_TEST | FEATURE_SPECULAR);
+
+    ProgramSource skyboxSource;
+    skyboxSource.name = "skybox";
+    skyboxSource.vertexPath = shaderFiles.path("skybox.vert");
+    skyboxSource.fragmentPath = shaderFiles.path("skybox.frag");
+    skyboxSource.vertex = shaderFiles.read(skyboxSource.vertexPath);
+    skyboxSource.fragment = shaderFiles.read(skyboxSource.fragmentPath);
+    ShaderBuildQueue::Handle skyboxProgram = buildQueue.submit(skyboxSource);
+
+    // sampler feedback reuses the regular vertex shader
+    ProgramSource feedbackSource;
+    feedbackSource.name = "feedback";
+    feedbackSource.vertexPath = sampleSource.vertexPath;
+    feedbackSource.fragmentPath = shaderFiles.path("feedback.frag");
+    feedbackSource.vertex = sampleSource.vertex;
+    feedbackSource.fragment = shaderFiles.read(feedbackSource.fragmentPath);
+    ShaderBuildQueue::Handle feedbackProgram = buildQueue.submit(feedbackSource);
+
+    // bounding boxes drawn for occlusion queries
+    ProgramSource boxSource;
+    boxSource.name = "box";
+    boxSource.vertexPath = shaderFiles.path("box.vert");
+    boxSource.fragmentPath = shaderFiles.path("box.frag");
+    boxSource.vertex = shaderFiles.read(boxSource.vertexPath);
+    boxSource.fragment = shaderFiles.read(boxSource.fragmentPath);
+    ShaderBuildQueue::Handle boxProgram = buildQueue.submit(boxSource);
+
+    // frustum culling on the GPU writing indirect draws, GL 4.3 only
+    ProgramSource cullSource;
+    cullSource.name = "cull";
+    cullSource.computePath = shaderFiles.path("cull.comp");
+    cullSource.compute = shaderFiles.read(cullSource.computePath);
+    ShaderBuildQueue::Handle cullProgram = -1;
+    if (GpuCuller::supported())
+        cullProgram = buildQueue.submit(cullSource);
+
+    // reflected uniforms of each program, uploads only go out when a value changed
+    // (the sample variants keep their own tables)
+    UniformTable skyboxUniforms, feedbackUniforms, boxUniforms, cullUniforms;
+
+    // saving a shader rebuilds the programs using it while the old ones keep drawing;
+    // only the override directory is watched, the embedded sources can't change
+    ShaderWatcher shaderWatcher;
+    if (shaderFiles.overridden()) {
+        ProgramSource* watchedSources[] = { &sampleSource, &skyboxSource, &feedbackSource, &boxSource, &cullSource };
+        for (ProgramSource* source : watchedSources) {
+            // a compute program has just the one stage
+            if (!source->vertexPath.empty())
+                shaderWatcher.watch(source->vertexPath);
+            if (!source->fragmentPath.empty())
+                shaderWatcher.watch(source->fragmentPath);
+            if (!source->computePath.empty())
+                shaderWatcher.watch(source->computePath);
+        }
     }
 
-    // create the shader program
-    GLuint shaderProg = glCreateProgram();
-    // attach the compiled vertex shader
-    glAttachShader(shaderProg, vertexShader);
-    // attach the compiled fragment shader
-    glAttachShader(shaderProg, fragShader);
-
-    // finalize the compilation process
-    glLinkProgram(shaderProg);
-
-    GLuint skyboxShaderProg = glCreateProgram();
-    glAttachShader(skyboxShaderProg, vertexShaderSkybox);
-    glAttachShader(skyboxShaderProg, fragShaderSkybox);
-
-    glLinkProgram(skyboxShaderProg);
-    glDeleteShader(vertexShaderSkybox);
-    glDeleteShader(fragShaderSkybox);
+    // records which mip of tex0 / norm_tex the visible texels need
+    TextureFeedback feedback(window_width, window_height);
 
     /*
       7--------6
@@ -408,36 +437,13 @@ int main(void)
         0,1,2
     };
 
-    GLuint VAO, VBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    // currently editing VAO = null
-    glBindVertexArray(VAO);
-    // currently editing VBO = null
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // new array of vertex data in the VBO
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * fullVertexData.size(), fullVertexData.data(), GL_DYNAMIC_DRAW);
-    // how to get position data from our array
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)0);
-    // since our UV starts at index 3, or the 4th index of our vertex data
-    GLintptr normPtr = 3 * sizeof(float);
-    // how to get normals data from our array
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)normPtr);
-    // since our UV starts at index 3, or the 4th index of our vertex data
-    GLintptr uvPtr = 6 * sizeof(float);
-    // how to get UV data from our array
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)uvPtr);
-
-    GLintptr tangentPtr = 8 * sizeof(float);
-    GLintptr bitangentPtr = 11 * sizeof(float);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)tangentPtr);
-    glVertexAttribPointer(4, 3,  GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)bitangentPtr);
-
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(4);
-    glEnableVertexAttribArray(3);
+    // vertices and indices of every mesh in one pair of buffers behind one
+    // VAO, suballocated as meshes come and go; the plane goes in first
+    const GLsizei kGeometryVertices = 1 << 18;
+    const GLsizei kGeometryIndices = 1 << 20;
+    GeometryPool geometry(kGeometryVertices, kGeometryIndices);
+    GLsizei planeVertexCount = (GLsizei)(fullVertexData.size() / GeometryPool::kFloatsPerVertex);
+    GeometryPool::Handle planeGeometry = geometry.allocate(fullVertexData.data(), planeVertexCount, nullptr, 0);
 
     unsigned int skyboxVAO, skyboxVBO, skyboxEBO;
     glGenVertexArrays(1, &skyboxVAO);
@@ -447,11 +453,11 @@ int main(void)
     glBindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glVertexAttribPointer(Skybox::Attrib::aPos, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, skyboxEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GL_INT) * 36, &skyboxIndices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(Skybox::Attrib::aPos);
 
     string facesSkybox[]{
         "Skybox/rainbow_rt.png",
@@ -473,6 +479,7 @@ int main(void)
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
+    size_t skyboxBytes = 0;
     for (unsigned int i = 0; i < 6; i++) {
         int w, h, skyCChannel;
         stbi_set_flip_vertically_on_load(false);
@@ -480,8 +487,11 @@ int main(void)
         if (data) {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
             stbi_image_free(data);
+            // drivers pad RGB out to 4 bytes per texel
+            skyboxBytes += (size_t)w * h * 4;
         }
     }
+    residency.trackStatic(skyboxTex, skyboxBytes);
     stbi_set_flip_vertically_on_load(true);
 
     // currently editing VBO = VBO
@@ -501,15 +511,16 @@ int main(void)
         1.f // zfar
     );*/
 
+    const float zFar = 100.f;
     glm::mat4 projectionMatrix = glm::perspective(
         glm::radians(60.f), // FOV
         window_height / window_width, // aspect ratio
         0.1f, // znear > 0
-        100.f // zfar
+        zFar // zfar
     );
 
     // position of the camera in the world / eye
-    glm::vec3 cameraPos = glm::vec3(x_mod, 0, 10.f);
+    glm::vec3 cameraPos = glm::vec3(0, 0, 10.f);
 
     // construct the position matrix using the eye
     glm::mat4 cameraPositionMatrix =
@@ -558,94 +569,345 @@ int main(void)
     float specStr = 0.5f;
     float specPhong = 16;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // the brick plane: normal mapped and shiny; a jpg has no alpha to cut out
+    int brickWidth = 0, brickHeight = 0, brickChannels = 0;
+    stbi_info("3D/brickwall.jpg", &brickWidth, &brickHeight, &brickChannels);
+    Material brick = { texture, norm_tex, brickChannels == 2 || brickChannels == 4, specStr, specPhong, false, brickTex, brickNormTex };
+    sampleVariants.prepare(brick.features());
+    // Scene::Renderable.material of the main scene indexes this
+    vector<Material> materials = { brick };
+
+    // the plane, spinning about x; the keys act on it
+    Bounds planeBounds = Bounds::empty();
+    // its positions are also what the occlusion culler draws for it
+    vector<glm::vec3> planeTriangles;
+    for (size_t i = 0; i < fullVertexData.size(); i += 14) {
+        planeTriangles.push_back(glm::vec3(fullVertexData[i], fullVertexData[i + 1], fullVertexData[i + 2]));
+        planeBounds.add(planeTriangles.back());
+    }
+    Entity plane = scene.create();
+    scene.setPosition(plane, glm::vec3(0, 3, 0));
+    scene.setScale(plane, glm::vec3(3));
+    scene.rotate(plane, 1.f, glm::vec3(1, 0, 0));
+    scene.setSpin(plane, 0.04f, glm::vec3(1, 0, 0));
+    scene.setLocalBounds(plane, planeBounds);
+    // a pool range drawn without indices: first is the first vertex
+    Scene::Renderable planeRenderable = { 0, geometry.vao(), planeVertexCount, false, geometry.range(planeGeometry).baseVertex, 0 };
+    scene.setRenderable(plane, planeRenderable);
+    controlled = plane;
+    // threads for the scene systems
+    WorkerPool workers;
+    // objects outside the camera frustum don't reach the render queue
+    FrustumCuller culler;
+    // neither do the ones behind the plane
+    OcclusionCuller occlusion;
+    // nor the ones whose box the GPU found hidden last time it was asked
+    OcclusionQueries occlusionQueries;
+
+    // program, VAO, texture and depth/blend state of the loop below goes
+    // through here so calls that change nothing are dropped
+    GLState glState;
+    // only the transparent pass turns blending on
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // every draw of a frame is a packet; sorting by pass, program, material
+    // and VAO binds each of them as few times as possible
+    RenderQueue renderQueue;
+    // the benchmark's own timer query can't be open around the pass timers
+    renderQueue.setPassTiming(!benchMode);
+    // runs of draws sharing program, textures and VAO as one multi draw, GL 4.3 only
+    renderQueue.setMultiDraw(true);
+
+    // queue an object drawn with the sample variant of its material, in the
+    // pass the material belongs to; materialId tells materials apart in the sort key
+    // instances > 0 draws that many copies from the instance attributes of vao
+    // first / baseVertex place the geometry in a GeometryPool's buffers (Scene::Renderable)
+    auto queueSampleDraw = [&](const Material& material, unsigned int materialId, GLuint vao, GLsizei count, bool indexed,
+        const glm::mat4& transform, const glm::mat3& normalMatrix, GLsizei instances, GLint first = 0, GLint baseVertex = 0) {
+        unsigned int features = material.features();
+        if (instances > 0)
+            features |= FEATURE_INSTANCED;
+        GLuint program = sampleVariants.program(features);
+        float distance = glm::length(glm::vec3(transform[3]) - cameraPos);
+
+        DrawPacket& packet = renderQueue.add();
+        packet.key = renderQueue.makeKey(material.pass(), program, materialId, vao, distance / zFar);
+        packet.program = program;
+        packet.uniforms = &sampleVariants.uniforms(features);
+        packet.vao = vao;
+        packet.count = count;
+        packet.indexed = indexed;
+        packet.first = first;
+        packet.baseVertex = baseVertex;
+        packet.instances = instances;
+        packet.textures[packet.textureCount++] = { Sample::Uniform::tex0, Sample::Unit::tex0, GL_TEXTURE_2D, material.albedo };
+        if (material.normalMap)
+            packet.textures[packet.textureCount++] = { Sample::Uniform::norm_tex, Sample::Unit::norm_tex, GL_TEXTURE_2D, material.normalMap };
+        packet.hasObject = true;
+        packet.object.transform = transform;
+        packet.object.normalMatrix = normalMatrix;
+        packet.object.specStr = material.specStr;
+        packet.object.specPhong = material.specPhong;
+        if (instances == 0 && renderQueue.multiDrawEnabled()) {
+            // batched only once its variant is built, drawn one by one until then
+            unsigned int batched = features | FEATURE_MULTI_DRAW;
+            sampleVariants.prepare(batched);
+            if (sampleVariants.ready(batched)) {
+                packet.batchProgram = sampleVariants.program(batched);
+                packet.batchUniforms = &sampleVariants.uniforms(batched);
+            }
+        }
+    };
+
+    // render system: every object of a scene that has something to draw and,
+    // given a FrustumCuller's visibility of the scene, is in view
+    auto queueScene = [&](const Scene& objects, const vector<Material>& objectMaterials, const vector<uint8_t>* visible) {
+        const vector<Scene::Renderable>& renderables = objects.renderables();
+        const vector<glm::mat4>& worlds = objects.worldMatrices();
+        const vector<glm::mat3>& normals = objects.normalMatrices();
+        for (size_t i = 0; i < objects.size(); i++) {
+            const Scene::Renderable& renderable = renderables[i];
+            if (renderable.count == 0 || (visible && !(*visible)[i]))
+                continue;
+            queueSampleDraw(objectMaterials[renderable.material], renderable.material, renderable.vao,
+                renderable.count, renderable.indexed, worlds[i], normals[i], 0, renderable.first, renderable.baseVertex);
+        }
+    };
+
+    // a single light for now, the block has room for FrameUniforms::kMaxLights
+    Light light;
+    light.position = glm::vec4(lightPos, 1.f);
+    light.color = glm::vec4(lightColor, 1.f);
+
+    // --bench: the cases draw through the same systems as the frame, in place of the scene
+    BenchCases::Context benchContext;
+    benchContext.sampleVariants = &sampleVariants;
+    benchContext.buildQueue = &buildQueue;
+    benchContext.streamer = &streamer;
+    benchContext.glState = &glState;
+    benchContext.objectUniforms = &objectUniforms;
+    benchContext.renderQueue = &renderQueue;
+    benchContext.workers = &workers;
+    benchContext.geometry = &geometry;
+    benchContext.queueSampleDraw = queueSampleDraw;
+    benchContext.queueScene = queueScene;
+    benchContext.brick = brick;
+    // the plane where the scene puts it, without the spin
+    benchContext.planeTransform = glm::scale(glm::translate(identity_matrix, scene.position(plane)), scene.scale(plane));
+    benchContext.planeRenderable = planeRenderable;
+    benchContext.planeBounds = planeBounds;
+    benchContext.planeTriangles = &planeTriangles;
+    benchContext.materials = &materials;
+    benchContext.viewProjection = projectionMatrix * viewMatrix;
+    // the skybox cube is the unit cube the box program wants
+    benchContext.boxProgram = boxProgram;
+    benchContext.boxUniforms = &boxUniforms;
+    benchContext.boxVAO = skyboxVAO;
+    benchContext.boxIndexCount = 36;
+    benchContext.cullProgram = cullProgram;
+    benchContext.cullUniforms = &cullUniforms;
+    BenchCases bench(benchContext, benchFrames);
+    if (benchMode)
+        bench.setup();
 
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(window))
     {
+        // upload the mips that finished streaming since last frame
+        streamer.update();
+        // uploads bind on whatever unit is active
+        glState.invalidateActiveUnit();
+        // recompile edited shaders, then pick up the programs the driver finished
+        vector<string> changedShaders = shaderWatcher.poll();
+        if (!changedShaders.empty()) {
+            buildQueue.reload(changedShaders);
+            sampleVariants.reload(changedShaders);
+        }
+        buildQueue.poll();
+
         /* Render here */
+        // the clear honours the depth mask, which the skybox pass leaves off
+        glState.depthMask(true);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        /*x = x_mod;
-        y = y_mod;
-        z = z_mod;
-        theta = theta_mod;
-        axis_x = axis_x_mod;
-        axis_y = axis_y_mod;
-        scale_x = scale_x_mod;
-        scale_y = scale_y_mod;*/
-
-        theta += 0.04f;
-
-        // Start with the translation matrix
-        glm::mat4 transformation_matrix = glm::translate(identity_matrix, glm::vec3(x, y, z));
-        // multiply the resulting matrix with the scale matrix
-        transformation_matrix = glm::scale(transformation_matrix, glm::vec3(scale_x, scale_y, scale_z));
-        // finally multiply it with the rotation matrix
-        transformation_matrix = glm::rotate(transformation_matrix, glm::radians(theta), glm::normalize(glm::vec3(axis_x, axis_y, axis_z)));
-
-        unsigned int projectionLoc = glGetUniformLocation(shaderProg, "projection");
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-        unsigned int transformLoc = glGetUniformLocation(shaderProg, "transform");
-        glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(transformation_matrix));
-        unsigned int viewLoc = glGetUniformLocation(shaderProg, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
-        glUseProgram(skyboxShaderProg);
-        glm::mat4 sky_view = glm::mat4(1.f);
-        sky_view = glm::mat4(glm::mat3(viewMatrix));
-
-        unsigned int skyboxViewLoc = glGetUniformLocation(skyboxShaderProg, "view");
-        glUniformMatrix4fv(skyboxViewLoc, 1, GL_FALSE, glm::value_ptr(sky_view));
-        unsigned int skyboxProjLoc = glGetUniformLocation(skyboxShaderProg, "projection");
-        glUniformMatrix4fv(skyboxProjLoc, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTex);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
-
-        // tell open GL to use this shader for the VAO/s below
-        glUseProgram(shaderProg);
-        glBindVertexArray(VAO);
-
-        glActiveTexture(GL_TEXTURE0);
-        // get the location of tex 0 in the fragment shader
-        GLuint texBLoc = glGetUniformLocation(shaderProg, "tex0");
-        // tell openGL to use the texture
-        glBindTexture(GL_TEXTURE_2D, texture);
-        // use the texture at 0
-        glUniform1i(texBLoc, 0);
-
-        glActiveTexture(GL_TEXTURE1);
-        GLuint tex1Loc = glGetUniformLocation(shaderProg, "norm_tex");
-        glBindTexture(GL_TEXTURE_2D, norm_tex);
-        glUniform1i(tex1Loc, 1);
-
-        GLuint lightAddress = glGetUniformLocation(shaderProg, "lightPos");
-        glUniform3fv(lightAddress, 1, glm::value_ptr(lightPos));
-        GLuint lightColorAddress = glGetUniformLocation(shaderProg, "lightColor");
-        glUniform3fv(lightColorAddress, 1, glm::value_ptr(lightColor));
-
-        GLuint ambientStrAddress = glGetUniformLocation(shaderProg, "ambientStr");
-        glUniform1f(ambientStrAddress, ambientStr);
-        GLuint ambientColorAddress = glGetUniformLocation(shaderProg, "ambientColor");
-        glUniform3fv(ambientColorAddress, 1, glm::value_ptr(ambientColor));
-
-        GLuint cameraPosAddress = glGetUniformLocation(shaderProg, "cameraPos");
-        glUniform3fv(cameraPosAddress, 1, glm::value_ptr(cameraPos));
-        GLuint specStrAddress = glGetUniformLocation(shaderProg, "specStr");
-        glUniform1f(specStrAddress, specStr);
-        GLuint specPhongAddress = glGetUniformLocation(shaderProg, "specPhong");
-        glUniform1f(specPhongAddress, specPhong);
-
-        // draw using uv
-        glDrawArrays(GL_TRIANGLES, 0, fullVertexData.size() / 14);
+        // scene systems: spin, then world matrices / bounds of what moved
+        scene.spin();
+        scene.updateTransforms(&workers);
+        // only what the camera can see goes to the queue
+        culler.setViewProjection(projectionMatrix * viewMatrix);
+        culler.cull(scene, &workers);
+        occlusion.begin(projectionMatrix * viewMatrix);
+        occlusion.addOccluder(planeTriangles, scene.worldMatrices()[scene.indexOf(plane)]);
+        occlusion.rasterize(&workers);
+        occlusion.cull(scene, culler.visible(), &workers);
+        occlusionQueries.collect();
+        occlusionQueries.cull(scene, occlusion.visible());
+
+        // view, projection and lighting go out once for every program below
+        frameUniforms.setCamera(viewMatrix, projectionMatrix, cameraPos);
+        frameUniforms.setLights(&light, 1);
+        frameUniforms.setAmbient(ambientColor, ambientStr);
+        frameUniforms.upload();
+
+        // --bench: the cases replace the scene until the last one is done
+        if (benchMode) {
+            // keep the full resolution mips resident without the feedback pass
+            residency.touch(brickTex, 0);
+            residency.touch(brickNormTex, 0);
+            residency.update();
+            glState.invalidateActiveUnit();
+            if (!bench.frame()) {
+                bench.report(cout);
+                break;
+            }
+            UniformTable::endFrame();
+            glState.endFrame();
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            continue;
+        }
+
+        // the skybox has nothing sensible to fall back to, it just shows up once linked;
+        // it is drawn after the geometry so the depth test rejects the covered pixels
+        if (buildQueue.ready(skyboxProgram)) {
+            GLuint skyboxShaderProg = buildQueue.program(skyboxProgram);
+            DrawPacket& skyboxPacket = renderQueue.add();
+            skyboxPacket.key = renderQueue.makeKey(PASS_SKYBOX, skyboxShaderProg, 0, skyboxVAO, 1.f);
+            skyboxPacket.program = skyboxShaderProg;
+            // the shader strips the translation out of FrameData.view itself
+            skyboxPacket.uniforms = &skyboxUniforms;
+            skyboxPacket.vao = skyboxVAO;
+            skyboxPacket.count = 36;
+            skyboxPacket.indexed = true;
+            skyboxPacket.textures[skyboxPacket.textureCount++] = { Skybox::Uniform::skybox, Skybox::Unit::skybox, GL_TEXTURE_CUBE_MAP, skyboxTex };
+        }
+
+        // cheapest variant for the material; a stand-in or the flat fallback until it has linked
+        queueScene(scene, materials, &occlusionQueries.visible());
+
+        renderQueue.sort();
+        renderQueue.submit(glState, objectUniforms);
+        renderQueue.clear();
+
+        // boxes against this frame's depth, the results are read next frame;
+        // the skybox cube is the unit cube the box program wants
+        if (buildQueue.ready(boxProgram)) {
+            occlusionQueries.issue(scene, occlusion.visible(), projectionMatrix * viewMatrix, glState,
+                buildQueue.program(boxProgram), boxUniforms, skyboxVAO, 36);
+        }
+
+        // low resolution pass that writes texture id + mip level per texel
+        if (feedback.wantsPass() && buildQueue.ready(feedbackProgram)) {
+            GLuint feedbackShaderProg = buildQueue.program(feedbackProgram);
+            // depth writes back on for the clear in begin(), no blending into the ids
+            glState.depthTest(true);
+            glState.depthMask(true);
+            glState.depthFunc(GL_LESS);
+            glState.blend(false);
+            feedback.begin();
+            glState.useProgram(feedbackShaderProg);
+            feedbackUniforms.bind(feedbackShaderProg);
+            // the albedo of each object is bound on tex0 below
+            feedbackUniforms.set(Feedback::Uniform::tex0, Sample::Unit::tex0);
+            feedbackUniforms.set(Feedback::Uniform::lodBias, feedback.lodBias());
+
+            // the objects queueScene() drew, each with its material's textures
+            const vector<Scene::Renderable>& renderables = scene.renderables();
+            const vector<uint8_t>& visible = occlusionQueries.visible();
+            for (size_t i = 0; i < scene.size(); i++) {
+                const Scene::Renderable& renderable = renderables[i];
+                if (renderable.count == 0 || !visible[i])
+                    continue;
+                const Material& material = materials[renderable.material];
+                glState.bindVertexArray(renderable.vao);
+                glState.bindTexture(Sample::Unit::tex0, GL_TEXTURE_2D, material.albedo);
+
+                // same object data as the object's packet, the upload is skipped
+                objectUniforms.data.transform = scene.worldMatrices()[i];
+                objectUniforms.data.normalMatrix = scene.normalMatrices()[i];
+                objectUniforms.data.specStr = material.specStr;
+                objectUniforms.data.specPhong = material.specPhong;
+                objectUniforms.upload();
+
+                // a texture that isn't streamed writes id bits 0, which the readback skips
+                glm::vec2 albedoSize(1.f), normalMapSize(1.f);
+                if (material.albedoHandle >= 0)
+                    albedoSize = glm::vec2(streamer.width(material.albedoHandle), streamer.height(material.albedoHandle));
+                if (material.normalMapHandle >= 0)
+                    normalMapSize = glm::vec2(streamer.width(material.normalMapHandle), streamer.height(material.normalMapHandle));
+                feedbackUniforms.set(Feedback::Uniform::tex0Id, (unsigned int)material.albedoHandle);
+                feedbackUniforms.set(Feedback::Uniform::normTexId, (unsigned int)material.normalMapHandle);
+                feedbackUniforms.set(Feedback::Uniform::tex0Size, albedoSize);
+                feedbackUniforms.set(Feedback::Uniform::normTexSize, normalMapSize);
+
+                const void* indices = (const void*)(renderable.first * sizeof(GLuint));
+                if (renderable.indexed)
+                    glDrawElementsBaseVertex(GL_TRIANGLES, renderable.count, GL_UNSIGNED_INT, indices, renderable.baseVertex);
+                else
+                    glDrawArrays(GL_TRIANGLES, renderable.first, renderable.count);
+            }
+            feedback.end();
+        }
+        feedback.collect();
+
+        // only textures the feedback saw on screen count as used, at the mip it saw
+        for (TextureStreamer::Handle handle = 0; handle < feedback.idCount(); handle++) {
+            int level = feedback.requiredLevel(handle);
+            if (level >= 0)
+                residency.touch(handle, level);
+        }
+        residency.update();
+        glState.invalidateActiveUnit();
+
+        if (print_stats) {
+            const TextureResidency::Stats& texStats = residency.getStats();
+            cout << "textures: " << texStats.residentBytes / 1024 << " / " << texStats.budgetBytes / 1024 << " KB resident, "
+                << texStats.evictions << " evictions, " << texStats.reloads << " reloads" << endl;
+            const ProgramCache::Stats& cacheStats = programCache.getStats();
+            cout << "program cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                << cacheStats.rejected << " rejected, " << buildQueue.pendingCount() << " still compiling, "
+                << buildQueue.swapCount() << " hot swaps"
+                << (buildQueue.parallel() ? " (parallel)" : "") << ", " << sampleVariants.builtCount()
+                << " sample variants" << endl;
+            const UniformTable::Stats& uniformStats = UniformTable::frameStats();
+            cout << "uniforms last frame: " << uniformStats.uploads << " uploads, " << uniformStats.skipped
+                << " unchanged skipped, " << uniformStats.lookupsSaved << " location lookups saved, "
+                << frameUniforms.skippedUploads() << " frame block uploads skipped" << endl;
+            const RenderQueue::Stats& queueStats = renderQueue.getStats();
+            cout << "render queue: " << queueStats.draws << " draws (" << queueStats.batchedDraws << " in "
+                << queueStats.multiDraws << " multi draws), " << queueStats.programChanges << " program, "
+                << queueStats.materialChanges << " material, " << queueStats.vaoChanges << " VAO changes" << endl;
+            cout << "passes (gpu ms since last report):";
+            for (int pass = 0; pass < kRenderPassCount; pass++) {
+                cout << " " << kRenderPassNames[pass] << " " << queueStats.passDraws[pass] << " draws "
+                    << fixed << setprecision(3) << renderQueue.passGpuMs(pass) << " ms" << (pass + 1 < kRenderPassCount ? "," : "");
+            }
+            cout << endl;
+            renderQueue.resetPassTimes();
+            const FrustumCuller::Stats& cullStats = culler.getStats();
+            cout << "culling last frame: " << cullStats.tested << " tested, " << cullStats.culled << " culled, "
+                << cullStats.drawn << " drawn" << endl;
+            const OcclusionCuller::Stats& occlusionStats = occlusion.getStats();
+            cout << "occlusion last frame: " << occlusionStats.occluders << " occluders, " << occlusionStats.triangles
+                << " triangles, " << occlusionStats.tested << " tested, " << occlusionStats.culled << " culled, "
+                << fixed << setprecision(3) << occlusionStats.rasterizeMs << " ms rasterize, "
+                << occlusionStats.testMs << " ms test" << endl;
+            const OcclusionQueries::Stats& queryStats = occlusionQueries.getStats();
+            cout << "occlusion queries last frame: " << queryStats.issued << " issued, " << queryStats.read << " read, "
+                << queryStats.stallsAvoided << " stalls avoided, " << queryStats.skipped << " objects skipped" << endl;
+            GeometryPool::Stats geometryStats = geometry.getStats();
+            cout << "geometry: " << geometryStats.allocations << " meshes, " << geometryStats.verticesUsed << " / "
+                << geometryStats.vertexCapacity << " vertices, " << geometryStats.indicesUsed << " / " << geometryStats.indexCapacity
+                << " indices, " << geometryStats.freeBlocks << " free blocks (largest " << geometryStats.largestFreeVertices
+                << " vertices, " << geometryStats.largestFreeIndices << " indices), " << geometryStats.defragmentations
+                << " defragmentations" << endl;
+            const GLState::Stats& stateStats = glState.frameStats();
+            cout << "gl state last frame: " << stateStats.issued << " calls issued, "
+                << stateStats.filtered << " redundant filtered" << endl;
+            print_stats = false;
+        }
+        UniformTable::endFrame();
+        glState.endFrame();
 
         /* Swap front and back buffers */
         glfwSwapBuffers(window);
@@ -653,8 +915,16 @@ int main(void)
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    bench.release();
+    geometry.release();
+    occlusionQueries.release();
+    buildQueue.release();
+    frameUniforms.release();
+    objectUniforms.release();
+    renderQueue.release();
+    streamer.release();
+    residency.release();
+    feedback.release();
 
     glfwTerminate();
     return 0;
@@ -1,47 +1,113 @@
 #version 330 core
 
+// feature bits, defined per variant by ShaderVariants:
+// NORMAL_MAP  perturb the normal with norm_tex
+// ALPHA_TEST  discard texels with alpha below 0.1
+// SPECULAR    add the Phong specular term
+// INSTANCED   per instance transform and tint (sample.vert)
+// MULTI_DRAW  ObjectData per draw of a multi draw, from sample.vert
+// LIGHT_COUNT lights shaded, at most the size of FrameData.lights
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+
 uniform sampler2D tex0;
+#ifdef NORMAL_MAP
 uniform sampler2D norm_tex;
+#endif
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform float ambientStr;
-uniform vec3 ambientColor;
-uniform vec3 cameraPos;
-uniform float specStr;
-uniform float specPhong;
+// per-frame data shared by every program, binding point 0
+struct Light {
+	vec4 position;
+	vec4 color;
+};
 
-in mat3 TBN;
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 cameraPos;
+	Light lights[4];
+	// rgb = ambient color, a = ambient strength
+	vec4 ambient;
+	int lightCount;
+};
 
-in vec2 texCoord;
+// per-draw data, binding point 1
+layout(std140) uniform ObjectData {
+	mat4 transform;
+	// transpose(inverse(mat3(transform))), computed once per object on the CPU
+	mat3 normalMatrix;
+	float specStr;
+	float specPhong;
+};
+
+// tangent space with NORMAL_MAP, world space otherwise (see sample.vert)
+in vec3 lightVec[LIGHT_COUNT];
+#ifdef SPECULAR
+in vec3 viewVec;
+#endif
+#ifndef NORMAL_MAP
 in vec3 normCoord;
-in vec3 fragPos;
+#endif
+
+in vec2 texCoord;
+#ifdef INSTANCED
+in vec4 tint;
+#endif
+#ifdef MULTI_DRAW
+flat in vec2 drawSpecular;
+#endif
 
 out vec4 FragColor;
 
 void main()
 {
 	vec4 pixelColor = texture(tex0, texCoord);
+#ifdef INSTANCED
+	pixelColor *= tint;
+#endif
+#ifdef ALPHA_TEST
 	if(pixelColor.a < 0.1) {
 		discard;
 	}
+#endif
 
+#ifdef NORMAL_MAP
 	vec3 normal = texture(norm_tex, texCoord).rgb;
 	normal = normalize(normal * 2.0 - 1.0);
-	normal = normalize(TBN * normal);
+#else
+	vec3 normal = normalize(normCoord);
+#endif
+
+	vec3 ambientCol = ambient.rgb * ambient.a;
+#ifdef SPECULAR
+	vec3 viewDir = normalize(viewVec);
+#ifdef MULTI_DRAW
+	float strength = drawSpecular.x;
+	float phong = drawSpecular.y;
+#else
+	float strength = specStr;
+	float phong = specPhong;
+#endif
+#endif
 
-	vec3 lightDir = normalize(lightPos - fragPos);
+	vec3 lighting = ambientCol;
+	for(int i = 0; i < min(lightCount, LIGHT_COUNT); i++) {
+		vec3 lightDir = normalize(lightVec[i]);
 
-	float diff = max(dot(normal, lightDir), 0.0);
-	vec3 diffuse = diff * lightColor;
+		float diff = max(dot(normal, lightDir), 0.0);
+		vec3 diffuse = diff * lights[i].color.rgb;
+		lighting += diffuse;
 
-	vec3 ambientCol = ambientColor * ambientStr;
+#ifdef SPECULAR
+		vec3 reflectDir = reflect(-lightDir, normal);
+
+		float spec = pow(max(dot(reflectDir, viewDir), 0.1), phong);
+		lighting += spec * strength * lights[i].color.rgb;
+#endif
+	}
 
-	vec3 viewDir = normalize(cameraPos - fragPos);
-	vec3 reflectDir = reflect(-lightDir, normal);
-	
-	float spec = pow(max(dot(reflectDir, viewDir), 0.1), specPhong);
-	vec3 specColor = spec * specStr * lightColor;
-	
-	FragColor = vec4(specColor + ambientCol + diffuse,1.0) * texture(tex0,texCoord);
+	FragColor = vec4(lighting,1.0) * pixelColor;
 }
\ No newline at end of file
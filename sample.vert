@@ -1,4 +1,9 @@
 #version 330 core
+#ifdef MULTI_DRAW
+// core in GL 4.3, which multi draw indirect needs anyway
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
 
 layout(location = 0) in vec3 aPos;
 layout(location = 2) in vec2 aTex;
@@ -7,29 +12,120 @@ layout(location = 3) in vec3 m_tan;
 layout(location = 4) in vec3 m_btan;
 
 layout(location = 1) in vec3 vertexNormal;
-out vec3 normCoord;
-out vec3 fragPos;
 
-out mat3 TBN;
+#ifdef INSTANCED
+// per instance (divisor 1): placement on top of ObjectData.transform, which
+// has to be a uniform scale as the normals only get renormalized, and a tint
+layout(location = 5) in mat4 instanceTransform;
+layout(location = 9) in vec4 instanceColor;
+
+out vec4 tint;
+#endif
+
+#ifdef MULTI_DRAW
+// per instance (divisor 1) counting 0, 1, 2, ...; a draw's base instance
+// makes it the index of the draw's DrawObjects entry
+layout(location = 10) in uint drawIndex;
+
+// the draw's specStr / specPhong for sample.frag
+flat out vec2 drawSpecular;
+#endif
+
+// lights the variant shades, set per program by the C++ side
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 4
+#endif
+
+// surface -> light / camera vectors; tangent space with NORMAL_MAP so the
+// fragment stage can use the normal map texel as is, world space otherwise
+out vec3 lightVec[LIGHT_COUNT];
+#ifdef SPECULAR
+out vec3 viewVec;
+#endif
+#ifndef NORMAL_MAP
+out vec3 normCoord;
+#endif
 
 out vec2 texCoord;
 
-uniform mat4 transform;
-uniform mat4 projection;
-uniform mat4 view;
+// per-frame data shared by every program, binding point 0
+struct Light {
+	vec4 position;
+	vec4 color;
+};
+
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 cameraPos;
+	Light lights[4];
+	// rgb = ambient color, a = ambient strength
+	vec4 ambient;
+	int lightCount;
+};
+
+// per-draw data, binding point 1
+layout(std140) uniform ObjectData {
+	mat4 transform;
+	// transpose(inverse(mat3(transform))), computed once per object on the CPU
+	mat3 normalMatrix;
+	float specStr;
+	float specPhong;
+};
+
+#ifdef MULTI_DRAW
+// ObjectData of every draw in a multi draw, same members so the std430
+// array has the std140 layout of the block; binding point 3
+struct DrawObject {
+	mat4 transform;
+	mat3 normalMatrix;
+	float specStr;
+	float specPhong;
+};
+
+layout(std430, binding = 3) readonly buffer DrawObjects {
+	DrawObject draws[];
+};
+#endif
 
 void main()
 {
-	mat3 modelMat = mat3(transpose(inverse(transform)));
-	normCoord = modelMat * vertexNormal;
+#ifdef MULTI_DRAW
+	mat4 transform = draws[drawIndex].transform;
+	mat3 normalMatrix = draws[drawIndex].normalMatrix;
+	drawSpecular = vec2(draws[drawIndex].specStr, draws[drawIndex].specPhong);
+#endif
+#ifdef INSTANCED
+	vec3 fragPos = vec3(transform * (instanceTransform * vec4(aPos, 1.0)));
+	mat3 instanceNormal = normalMatrix * mat3(instanceTransform);
+	tint = instanceColor;
+#else
+	vec3 fragPos = vec3(transform * vec4(aPos, 1.0));
+	mat3 instanceNormal = normalMatrix;
+#endif
+	vec3 N = normalize(instanceNormal * vertexNormal);
 
-	vec3 T = normalize(modelMat * m_tan);
-	vec3 B = normalize(modelMat * m_btan);
-	vec3 N = normalize(normCoord);
-	TBN = mat3(T, B, N);
+#ifdef NORMAL_MAP
+	// orthonormal basis, so its transpose takes world vectors into tangent space
+	vec3 T = normalize(instanceNormal * m_tan);
+	T = normalize(T - dot(T, N) * N);
+	vec3 B = cross(N, T);
+	if (dot(B, instanceNormal * m_btan) < 0.0)
+		B = -B;
+	mat3 worldToTangent = transpose(mat3(T, B, N));
+#else
+	mat3 worldToTangent = mat3(1.0);
+	normCoord = N;
+#endif
 
-	fragPos = vec3(transform * vec4(aPos, 1.0));
+	for(int i = 0; i < LIGHT_COUNT; i++) {
+		lightVec[i] = worldToTangent * (lights[i].position.xyz - fragPos);
+	}
+#ifdef SPECULAR
+	viewVec = worldToTangent * (cameraPos.xyz - fragPos);
+#endif
 
-	gl_Position = projection * view * transform * vec4(aPos, 1.0);
+	gl_Position = viewProj * vec4(fragPos, 1.0);
 	texCoord = aTex;
 }
\ No newline at end of file
@@ -4,12 +4,27 @@ layout(location = 0) in vec3 aPos;
 
 out vec3 texCoord;
 
-uniform mat4 projection;
-uniform mat4 view;
+// per-frame data shared by every program, binding point 0
+struct Light {
+	vec4 position;
+	vec4 color;
+};
+
+layout(std140) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProj;
+	vec4 cameraPos;
+	Light lights[4];
+	// rgb = ambient color, a = ambient strength
+	vec4 ambient;
+	int lightCount;
+};
 
 void main()
 {
-	vec4 pos = projection * view * vec4(aPos, 1.0);
+	// drop the translation so the box stays centered on the camera
+	vec4 pos = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
 
 	gl_Position = vec4(pos.x, pos.y, pos.w, pos.w);
 	texCoord = aPos;